@@ -3,7 +3,18 @@
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Most sectors in a transfer that merges adjacent requests. */
+#define MAX_MERGE_SECTORS 32
+
+/* How long the deadline scheduler lets a read or a write wait,
+   in timer ticks, before serving it ahead of the elevator. */
+#define READ_EXPIRE (TIMER_FREQ / 2)
+#define WRITE_EXPIRE (TIMER_FREQ * 5)
 
 /* A block device. */
 struct block
@@ -19,6 +30,25 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+
+    /* Request queue, served by the device's I/O thread.  Devices
+       whose driver has a map operation, such as partitions, have
+       no queue of their own; their requests go to the queue of
+       the device they map onto. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct condition queue_cond;        /* Signaled when a request arrives. */
+    struct list queue;                  /* Waiting requests, oldest first. */
+    bool busy;                          /* Is a transfer in progress? */
+    block_sector_t head;                /* Sector after the last transfer. */
+    uint8_t *bounce;                    /* Staging for merged transfers. */
+
+    /* Queue statistics. */
+    unsigned long long req_cnt;         /* Requests submitted. */
+    unsigned long long merge_cnt;       /* Requests merged into others. */
+    unsigned long long depth_sum;       /* Sum of depths seen on submit. */
+    size_t max_depth;                   /* Deepest queue seen on submit. */
+    int64_t latency_sum;                /* Sum of ticks until completion. */
+    int64_t max_latency;                /* Longest ticks until completion. */
   };
 
 /* List of all block devices. */
@@ -27,7 +57,36 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
+/* Order in which queued requests are served. */
+static enum block_scheduler scheduler = BLOCK_SCHED_DEADLINE;
+
 static struct block *list_elem_to_block (struct list_elem *);
+static void transfer_sync (struct block *, block_sector_t, size_t cnt,
+                           void *buffer, bool write);
+static void io_thread (void *block_);
+
+/* Returns a human-readable name for the given block SCHEDULER. */
+const char *
+block_scheduler_name (enum block_scheduler scheduler)
+{
+  static const char *block_scheduler_names[] =
+    {
+      "fifo",
+      "clook",
+      "deadline",
+    };
+
+  ASSERT (scheduler <= BLOCK_SCHED_DEADLINE);
+  return block_scheduler_names[scheduler];
+}
+
+/* Makes every block device serve its queued requests in the
+   order chosen by SCHEDULER. */
+void
+block_set_scheduler (enum block_scheduler scheduler_)
+{
+  scheduler = scheduler_;
+}
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -120,9 +179,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  transfer_sync (block, sector, 1, buffer, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +190,319 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  transfer_sync (block, sector, 1, (void *) buffer, true);
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  They are transferred with a single request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  if (cnt > 0)
+    transfer_sync (block, sector, cnt, buffer, false);
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   They are transferred with a single request.  Returns after
+   the block device has acknowledged receiving the data.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *buffer)
+{
+  if (cnt > 0)
+    transfer_sync (block, sector, cnt, (void *) buffer, true);
+}
+
+/* Initializes R as a request to transfer CNT sectors starting
+   at SECTOR between a block device and BUFFER, which must have
+   room for CNT * BLOCK_SECTOR_SIZE bytes.  The request reads
+   into BUFFER, or writes from it if WRITE is true.  If COMPLETE
+   is non-null, it is called with R and AUX when the transfer is
+   done, just before R's waiter is woken. */
+void
+block_request_init (struct block_request *r, block_sector_t sector,
+                    size_t cnt, void *buffer, bool write,
+                    block_complete_func *complete, void *aux)
+{
+  ASSERT (r != NULL);
+  ASSERT (cnt > 0);
+
+  r->sector = sector;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->write = write;
+  r->complete = complete;
+  r->aux = aux;
+  sema_init (&r->done, 0);
+}
+
+/* Queues request R for BLOCK and returns without waiting for
+   the transfer.  R must stay in place, and its buffer must not
+   be touched, until it completes; block_wait() waits for that.
+   Requests complete in the device's I/O thread, so R's COMPLETE
+   function must not wait for I/O on the same device. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  size_t depth;
+
+  check_sector (block, r->sector);
+  check_sector (block, r->sector + r->cnt - 1);
+  if (r->write)
+    {
+      ASSERT (block->type != BLOCK_FOREIGN);
+      block->write_cnt += r->cnt;
+    }
+  else
+    block->read_cnt += r->cnt;
+
+  r->dev_sector = r->sector;
+  while (block->ops->map != NULL)
+    block = block->ops->map (block->aux, &r->dev_sector);
+  r->submitted = timer_ticks ();
+
+  lock_acquire (&block->queue_lock);
+  depth = list_size (&block->queue) + block->busy;
+  block->req_cnt++;
+  block->depth_sum += depth;
+  if (depth > block->max_depth)
+    block->max_depth = depth;
+  list_push_back (&block->queue, &r->elem);
+  cond_signal (&block->queue_cond, &block->queue_lock);
+  lock_release (&block->queue_lock);
+}
+
+/* Waits until request R, which must have been submitted with
+   block_submit(), completes.  Only one thread may wait for a
+   given request, and only once. */
+void
+block_wait (struct block_request *r)
+{
+  sema_down (&r->done);
+}
+
+/* Transfers CNT sectors starting at SECTOR between BLOCK and
+   BUFFER, waiting for the transfer to complete. */
+static void
+transfer_sync (struct block *block, block_sector_t sector, size_t cnt,
+               void *buffer, bool write)
+{
+  struct block_request r;
+
+  block_request_init (&r, sector, cnt, buffer, write, NULL, NULL);
+  block_submit (block, &r);
+  block_wait (&r);
+}
+
+/* Has BLOCK's driver transfer CNT sectors starting at SECTOR to
+   or from BUFFER. */
+static void
+transfer (struct block *block, block_sector_t sector, size_t cnt,
+          uint8_t *buffer, bool write)
+{
+  size_t i;
+
+  if (write && block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else if (!write && block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      if (write)
+        block->ops->write (block->aux, sector + i,
+                           buffer + i * BLOCK_SECTOR_SIZE);
+      else
+        block->ops->read (block->aux, sector + i,
+                          buffer + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Returns the request in BLOCK's queue with the lowest sector
+   at or after SECTOR, or failing that the lowest sector
+   overall, so that the disk head sweeps in one direction and
+   then jumps back (C-LOOK). */
+static struct block_request *
+pick_clook (struct block *block, block_sector_t sector)
+{
+  struct block_request *ahead = NULL, *lowest = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&block->queue); e != list_end (&block->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (lowest == NULL || r->dev_sector < lowest->dev_sector)
+        lowest = r;
+      if (r->dev_sector >= sector
+          && (ahead == NULL || r->dev_sector < ahead->dev_sector))
+        ahead = r;
+    }
+  return ahead != NULL ? ahead : lowest;
+}
+
+/* Removes and returns the request that BLOCK should serve next
+   according to the scheduler, or returns a null pointer if its
+   queue is empty.  BLOCK's queue_lock must be held. */
+static struct block_request *
+pick_request (struct block *block)
+{
+  struct block_request *r = NULL;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&block->queue_lock));
+
+  if (list_empty (&block->queue))
+    return NULL;
+
+  switch (scheduler)
+    {
+    case BLOCK_SCHED_FIFO:
+      r = list_entry (list_front (&block->queue), struct block_request, elem);
+      break;
+
+    case BLOCK_SCHED_DEADLINE:
+      /* Serve the oldest expired request, if any. */
+      for (e = list_begin (&block->queue); e != list_end (&block->queue);
+           e = list_next (e))
+        {
+          struct block_request *q = list_entry (e, struct block_request, elem);
+          if (timer_elapsed (q->submitted)
+              >= (q->write ? WRITE_EXPIRE : READ_EXPIRE))
+            {
+              r = q;
+              break;
+            }
+        }
+      if (r == NULL)
+        r = pick_clook (block, block->head);
+      break;
+
+    case BLOCK_SCHED_CLOOK:
+      r = pick_clook (block, block->head);
+      break;
+    }
+
+  list_remove (&r->elem);
+  return r;
+}
+
+/* Records in BLOCK's statistics that request R has completed.
+   BLOCK's queue_lock must be held. */
+static void
+account_latency (struct block *block, const struct block_request *r)
+{
+  int64_t latency = timer_elapsed (r->submitted);
+
+  block->latency_sum += latency;
+  if (latency > block->max_latency)
+    block->max_latency = latency;
+}
+
+/* I/O thread for BLOCK.  Transfers the queued request that the
+   scheduler picks, together with queued requests for adjacent
+   sectors in the same direction, and completes them. */
+static void
+io_thread (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct block_request *run[MAX_MERGE_SECTORS];
+      struct block_request *r;
+      size_t run_cnt, run_sectors;
+      block_sector_t start, end;
+      struct list_elem *e;
+      size_t i;
+
+      lock_acquire (&block->queue_lock);
+      while (list_empty (&block->queue))
+        cond_wait (&block->queue_cond, &block->queue_lock);
+      r = pick_request (block);
+      block->busy = true;
+
+      /* Take along queued requests that extend R at either end,
+         as long as they fit in the bounce buffer. */
+      run[0] = r;
+      run_cnt = 1;
+      run_sectors = r->cnt;
+      start = r->dev_sector;
+      end = r->dev_sector + r->cnt;
+      e = list_begin (&block->queue);
+      while (e != list_end (&block->queue) && run_cnt < MAX_MERGE_SECTORS)
+        {
+          struct block_request *q = list_entry (e, struct block_request, elem);
+          if (q->write != r->write || run_sectors + q->cnt > MAX_MERGE_SECTORS
+              || (q->dev_sector != end && q->dev_sector + q->cnt != start))
+            {
+              e = list_next (e);
+              continue;
+            }
+
+          if (q->dev_sector == end)
+            {
+              run[run_cnt++] = q;
+              end += q->cnt;
+            }
+          else
+            {
+              memmove (run + 1, run, run_cnt * sizeof *run);
+              run[0] = q;
+              run_cnt++;
+              start = q->dev_sector;
+            }
+          run_sectors += q->cnt;
+          list_remove (&q->elem);
+
+          /* The run grew, so earlier requests may fit now. */
+          e = list_begin (&block->queue);
+        }
+      block->merge_cnt += run_cnt - 1;
+      lock_release (&block->queue_lock);
+
+      if (run_cnt == 1)
+        transfer (block, start, run_sectors, r->buffer, r->write);
+      else
+        {
+          uint8_t *p;
+
+          if (r->write)
+            for (i = 0, p = block->bounce; i < run_cnt; i++)
+              {
+                memcpy (p, run[i]->buffer, run[i]->cnt * BLOCK_SECTOR_SIZE);
+                p += run[i]->cnt * BLOCK_SECTOR_SIZE;
+              }
+          transfer (block, start, run_sectors, block->bounce, r->write);
+          if (!r->write)
+            for (i = 0, p = block->bounce; i < run_cnt; i++)
+              {
+                memcpy (run[i]->buffer, p, run[i]->cnt * BLOCK_SECTOR_SIZE);
+                p += run[i]->cnt * BLOCK_SECTOR_SIZE;
+              }
+        }
+
+      lock_acquire (&block->queue_lock);
+      block->head = end;
+      block->busy = false;
+      for (i = 0; i < run_cnt; i++)
+        account_latency (block, run[i]);
+      lock_release (&block->queue_lock);
+
+      /* A request may be reused or go out of scope as soon as
+         its waiter wakes up, so this is the last use of each. */
+      for (i = 0; i < run_cnt; i++)
+        {
+          if (run[i]->complete != NULL)
+            run[i]->complete (run[i], run[i]->aux);
+          sema_up (&run[i]->done);
+        }
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,10 +526,12 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Prints statistics for each block device used for a Pintos role,
+   and for the request queue of each device that has one. */
 void
 block_print_stats (void)
 {
+  struct list_elem *e;
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
@@ -176,6 +544,24 @@ block_print_stats (void)
                   block->read_cnt, block->write_cnt);
         }
     }
+
+  for (e = list_begin (&all_blocks); e != list_end (&all_blocks);
+       e = list_next (e))
+    {
+      struct block *block = list_entry (e, struct block, list_elem);
+      if (block->req_cnt > 0)
+        printf ("%s queue (%s): %llu requests, %llu merged, "
+                "depth %llu.%02llu avg %zu max, "
+                "latency %lld.%02lld avg %lld max ticks\n",
+                block->name, block_scheduler_name (scheduler),
+                block->req_cnt, block->merge_cnt,
+                block->depth_sum / block->req_cnt,
+                block->depth_sum * 100 / block->req_cnt % 100,
+                block->max_depth,
+                block->latency_sum / (int64_t) block->req_cnt,
+                block->latency_sum * 100 / (int64_t) block->req_cnt % 100,
+                block->max_latency);
+    }
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -200,6 +586,18 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_cond);
+  list_init (&block->queue);
+  block->busy = false;
+  block->head = 0;
+  block->bounce = NULL;
+  block->req_cnt = 0;
+  block->merge_cnt = 0;
+  block->depth_sum = 0;
+  block->max_depth = 0;
+  block->latency_sum = 0;
+  block->max_latency = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -208,6 +606,21 @@ block_register (const char *name, enum block_type type,
     printf (", %s", extra_info);
   printf ("\n");
 
+  if (ops->map == NULL)
+    {
+      char thread_name[sizeof block->name + 3];
+
+      block->bounce = malloc (MAX_MERGE_SECTORS * BLOCK_SECTOR_SIZE);
+      if (block->bounce == NULL)
+        PANIC ("Failed to allocate memory for block device queue");
+
+      /* The I/O thread mostly waits for the device, so it runs
+         ahead of the threads waiting for its transfers. */
+      snprintf (thread_name, sizeof thread_name, "%s-io", block->name);
+      if (thread_create (thread_name, PRI_MAX, io_thread, block) == TID_ERROR)
+        PANIC ("Failed to start I/O thread for %s", block->name);
+    }
+
   return block;
 }
 
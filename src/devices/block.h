@@ -1,8 +1,11 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <list.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -41,6 +44,17 @@ enum block_type
 
 const char *block_type_name (enum block_type);
 
+/* Order in which a block device serves queued requests. */
+enum block_scheduler
+  {
+    BLOCK_SCHED_FIFO,            /* Arrival order. */
+    BLOCK_SCHED_CLOOK,           /* Ascending sectors, wrapping around. */
+    BLOCK_SCHED_DEADLINE         /* C-LOOK, but expired requests first. */
+  };
+
+const char *block_scheduler_name (enum block_scheduler);
+void block_set_scheduler (enum block_scheduler);
+
 /* Finding block devices. */
 struct block *block_get_role (enum block_type);
 void block_set_role (enum block_type, struct block *);
@@ -53,9 +67,42 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt, void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Asynchronous block device operations.  The synchronous
+   functions above are built on these. */
+struct block_request;
+typedef void block_complete_func (struct block_request *, void *aux);
+
+/* A transfer of consecutive sectors.  Initialize it with
+   block_request_init(), then pass it to block_submit(). */
+struct block_request
+  {
+    /* Set by block_request_init(). */
+    block_sector_t sector;              /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+    void *buffer;                       /* Data, CNT sectors long. */
+    bool write;                         /* Write, as opposed to read? */
+    block_complete_func *complete;      /* Called when done, or null. */
+    void *aux;                          /* Passed to COMPLETE. */
+
+    /* Owned by the block layer. */
+    struct list_elem elem;              /* Element in a device queue. */
+    block_sector_t dev_sector;          /* SECTOR on the queuing device. */
+    int64_t submitted;                  /* Timer tick when submitted. */
+    struct semaphore done;              /* Upped when done. */
+  };
+
+void block_request_init (struct block_request *, block_sector_t, size_t cnt,
+                         void *buffer, bool write,
+                         block_complete_func *, void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+
 /* Statistics. */
 void block_print_stats (void);
 
@@ -63,8 +110,24 @@ void block_print_stats (void);
 
 struct block_operations
   {
+    /* Transfer one sector.  Null for mapped devices; see MAP
+       below. */
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Transfer CNT consecutive sectors at once.  If
+       null, the block layer makes one call per sector instead. */
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
+
+    /* Optional.  For devices that are a window onto another block
+       device, such as partitions: translates *SECTOR into a
+       sector of the other device and returns that device.  The
+       block layer then queues requests on the other device, and
+       the operations above may be null. */
+    struct block *(*map) (void *aux, block_sector_t *sector);
   };
 
 struct block *block_register (const char *name, enum block_type,
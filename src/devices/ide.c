@@ -34,6 +34,7 @@
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +50,17 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+
+/* Most sectors transferred by one command.  The sector count
+   register is 8 bits wide. */
+#define MAX_CMD_SECTORS 255
+
+/* Most sectors per data block we ask for with SET MULTIPLE MODE:
+   one page. */
+#define MAX_MULT_SECTORS 8
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +69,8 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int mult_cnt;               /* Sectors per data block for READ/WRITE
+                                   MULTIPLE, or 0 if not enabled. */
   };
 
 /* An ATA channel (aka controller).
@@ -85,10 +99,11 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sectors (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sectors (struct channel *, void *, size_t cnt);
+static void output_sectors (struct channel *, const void *, size_t cnt);
+static void set_multiple_mode (struct ata_disk *, int max_mult_cnt);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
@@ -136,6 +151,7 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->mult_cnt = 0;
         }
 
       /* Register interrupt handler. */
@@ -279,7 +295,7 @@ identify_ata_device (struct ata_disk *d)
       d->is_ata = false;
       return;
     }
-  input_sector (c, id);
+  input_sectors (c, id, 1);
 
   /* Calculate capacity.
      Read model name and serial number. */
@@ -303,6 +319,10 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  /* Transfer several sectors per interrupt if the disk can.
+     Word 47 gives the most sectors per data block. */
+  set_multiple_mode (d, *(uint16_t *) &id[47 * 2] & 0xff);
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
@@ -337,63 +357,161 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
+/* Enables READ MULTIPLE and WRITE MULTIPLE on disk D with the
+   largest power of 2 that is at most MAX_MULT_CNT and
+   MAX_MULT_SECTORS as the data block size.  Leaves them disabled
+   if MAX_MULT_CNT is 0 or the disk rejects the command. */
+static void
+set_multiple_mode (struct ata_disk *d, int max_mult_cnt)
+{
+  struct channel *c = d->channel;
+  int mult_cnt;
+
+  for (mult_cnt = MAX_MULT_SECTORS; mult_cnt > max_mult_cnt; mult_cnt /= 2)
+    continue;
+  if (mult_cnt <= 1)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), mult_cnt);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_alt_status (c)) & STA_ERR) == 0)
+    d->mult_cnt = mult_cnt;
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.  Each
+   command transfers up to MAX_CMD_SECTORS sectors, and the disk
+   interrupts once per data block of D->mult_cnt sectors, or once
+   per sector if multiple mode is not enabled.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt, void *buffer_)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  uint8_t *buffer = buffer_;
+  size_t block_size = d->mult_cnt > 0 ? (size_t) d->mult_cnt : 1;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
+  while (cnt > 0)
+    {
+      size_t cmd_cnt = cnt < MAX_CMD_SECTORS ? cnt : MAX_CMD_SECTORS;
+      size_t ofs;
+
+      select_sectors (d, sec_no, cmd_cnt);
+      issue_pio_command (c, d->mult_cnt > 0
+                            ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY);
+      for (ofs = 0; ofs < cmd_cnt; ofs += block_size)
+        {
+          size_t block_cnt = cmd_cnt - ofs < block_size ? cmd_cnt - ofs : block_size;
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+                   (block_sector_t) (sec_no + ofs));
+          input_sectors (c, buffer + ofs * BLOCK_SECTOR_SIZE, block_cnt);
+        }
+
+      sec_no += cmd_cnt;
+      buffer += cmd_cnt * BLOCK_SECTOR_SIZE;
+      cnt -= cmd_cnt;
+    }
   lock_release (&c->lock);
 }
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the disk has acknowledged receiving the data.  Commands
+   and interrupts are as for ide_read_multiple().
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *buffer_)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
+  const uint8_t *buffer = buffer_;
+  size_t block_size = d->mult_cnt > 0 ? (size_t) d->mult_cnt : 1;
+
   lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
+  while (cnt > 0)
+    {
+      size_t cmd_cnt = cnt < MAX_CMD_SECTORS ? cnt : MAX_CMD_SECTORS;
+      size_t ofs;
+
+      select_sectors (d, sec_no, cmd_cnt);
+      issue_pio_command (c, d->mult_cnt > 0
+                            ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY);
+      for (ofs = 0; ofs < cmd_cnt; ofs += block_size)
+        {
+          size_t block_cnt = cmd_cnt - ofs < block_size ? cmd_cnt - ofs : block_size;
+
+          /* The disk interrupts after each data block, but asks
+             for the first one without interrupting. */
+          if (ofs > 0)
+            sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+                   (block_sector_t) (sec_no + ofs));
+          output_sectors (c, buffer + ofs * BLOCK_SECTOR_SIZE, block_cnt);
+        }
+      sema_down (&c->completion_wait);
+
+      sec_no += cmd_cnt;
+      buffer += cmd_cnt * BLOCK_SECTOR_SIZE;
+      cnt -= cmd_cnt;
+    }
   lock_release (&c->lock);
 }
 
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read (void *d_, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d_, sec_no, 1, buffer);
+}
+
+/* Write sector SEC_NO to disk D from BUFFER, which must contain
+   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
+   acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+{
+  ide_write_multiple (d_, sec_no, 1, buffer);
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    NULL
   };
-
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO to the disk's sector selection registers and CNT,
+   which must be between 1 and MAX_CMD_SECTORS, to its sector
+   count register.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sectors (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= MAX_CMD_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -414,20 +532,21 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) 
+input_sectors (struct channel *c, void *sectors, size_t cnt) 
 {
-  insw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  insw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain BLOCK_SECTOR_SIZE bytes. */
+/* Writes SECTORS to channel C's data register in PIO mode.
+   SECTORS must contain CNT * BLOCK_SECTOR_SIZE bytes. */
 static void
-output_sector (struct channel *c, const void *sector) 
+output_sectors (struct channel *c, const void *sectors, size_t cnt) 
 {
-  outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  outsw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
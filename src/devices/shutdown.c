@@ -5,13 +5,22 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/sched-trace.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
+#include "userprog/process.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
+#include "filesys/fs-cache.h"
+#endif
+#ifdef VM
+#include "vm/frame_table.h"
+#include "vm/suppl_page_table.h"
+#include "vm/swap_table.h"
 #endif
 
 /* Keyboard control register port. */
@@ -130,12 +139,21 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  sched_trace_print_stats ();
+  mutex_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
+  fs_cache_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  process_print_stats ();
+#endif
+#ifdef VM
+  suppl_page_table_print_stats ();
+  frame_table_print_stats ();
+  swap_table_print_stats ();
 #endif
 }
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/io.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -20,6 +21,15 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* PIT cycles per timer tick, as loaded into channel 0 by
+   pit_configure_channel(). */
+#define PIT_CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Master PIC command port, and the command that makes the next
+   read from it return the interrupt request register. */
+#define PIC0_CTRL 0x20
+#define PIC_READ_IRR 0x0a
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -76,6 +86,33 @@ timer_ticks (void)
   return t;
 }
 
+/* Returns the number of microseconds since the OS booted, to
+   the resolution of the PIT's counter, about 1 us, rather than
+   of the timer tick. */
+int64_t
+timer_usecs (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t t = ticks;
+  unsigned cycles = PIT_CYCLES_PER_TICK - pit_read_channel (0);
+
+  /* If the counter has started over but the timer interrupt has
+     not been handled yet, it is still pending: count its tick,
+     so that the time does not go backward.  A count read just
+     before it started over belongs to the old tick, so count
+     from the start of the new one instead. */
+  outb (PIC0_CTRL, PIC_READ_IRR);
+  if (inb (PIC0_CTRL) & 1)
+    {
+      t++;
+      if (cycles > PIT_CYCLES_PER_TICK / 2)
+        cycles = 0;
+    }
+  intr_set_level (old_level);
+
+  return t * (1000000 / TIMER_FREQ) + (int64_t) cycles * 1000000 / PIT_HZ;
+}
+
 /* Returns the number of timer ticks elapsed since THEN, which
    should be a value once returned by timer_ticks(). */
 int64_t
@@ -0,0 +1,55 @@
+/* top.c
+
+   Prints the CPU time, context switches, page faults, resident
+   pages and file I/O of every thread, busiest first. */
+
+#include <procstat.h>
+#include <stdio.h>
+#include <syscall.h>
+
+#define MAX_THREADS 64
+
+static struct procstat stats[MAX_THREADS];
+
+static long long
+total_ticks (const struct procstat *s) 
+{
+  return s->user_ticks + s->kernel_ticks;
+}
+
+int
+main (void) 
+{
+  int cnt = procstat (stats, MAX_THREADS);
+  int i, j;
+
+  if (cnt < 0)
+    {
+      printf ("top: procstat failed\n");
+      return EXIT_FAILURE;
+    }
+
+  /* Sort by total ticks, busiest first. */
+  for (i = 1; i < cnt; i++)
+    for (j = i; j > 0 && total_ticks (&stats[j - 1]) < total_ticks (&stats[j]);
+         j--)
+      {
+        struct procstat tmp = stats[j];
+        stats[j] = stats[j - 1];
+        stats[j - 1] = tmp;
+      }
+
+  printf ("%5s %-15s %c %4s %8s %8s %7s %7s %6s %5s %10s %10s\n",
+          "PID", "NAME", 'S', "PRI", "USER", "KERNEL", "VOLCS", "INVCS",
+          "FAULTS", "RSS", "READ", "WRITTEN");
+  for (i = 0; i < cnt; i++)
+    {
+      const struct procstat *s = &stats[i];
+      printf ("%5d %-15s %c %4d %8lld %8lld %7u %7u %6u %5u %10lld %10lld\n",
+              s->pid, s->name, s->state, s->priority, s->user_ticks,
+              s->kernel_ticks, s->voluntary_switches,
+              s->involuntary_switches, s->page_faults, s->resident_pages,
+              s->bytes_read, s->bytes_written);
+    }
+  return EXIT_SUCCESS;
+}
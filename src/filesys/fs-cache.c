@@ -1,35 +1,165 @@
 #include "fs-cache.h"
+#include <hash.h>
 #include <list.h>
+#include <round.h>
+#include <stdio.h>
 #include <string.h>
 #include "devices/timer.h"
 #include "filesys/filesys.h"
-#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
-
-/* From 5.3.4 Buffer Cache. */
-#define MAX_BUFFER_LIST_SIZE 64
-
+#include "threads/vaddr.h"
+
+/* Default number of cached sectors, from 5.3.4 Buffer Cache. */
+#define DEFAULT_CACHE_SIZE 64
+
+/* Sector buffers are carved out of slabs of SLAB_PAGE_CNT
+   contiguous pages from the user pool, so that
+   frame_table_install() can take them back through
+   fs_cache_shrink() when user memory runs out. */
+#define SLAB_PAGE_CNT 8
+#define SLAB_SECTOR_CNT (SLAB_PAGE_CNT * PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Most dirty sectors the flusher pins at once. */
+#define FLUSH_BATCH_SIZE 64
+
+/* Most sectors a read-ahead worker reads at once. */
+#define READ_AHEAD_BATCH_SIZE 32
+
+/* The flusher and each read-ahead worker stage their batches in
+   bounce buffers of their own, so that runs of adjacent sectors,
+   whose buffers are scattered over the slabs, go to the disk as
+   single requests.  Every run of a batch is submitted before the
+   first one is waited for. */
+#define FLUSH_BOUNCE_PAGES \
+  DIV_ROUND_UP (FLUSH_BATCH_SIZE * BLOCK_SECTOR_SIZE, PGSIZE)
+#define READ_AHEAD_BOUNCE_PAGES \
+  DIV_ROUND_UP (READ_AHEAD_BATCH_SIZE * BLOCK_SECTOR_SIZE, PGSIZE)
+
+/* Write-back thresholds.  A dirty sector is written back once it
+   has been dirty for DIRTY_AGE ticks, and every dirty sector is
+   written back while more than DIRTY_RATIO percent of the cache
+   is dirty.  While there is dirty data, the flusher checks them
+   every FLUSH_POLL ticks; otherwise it sleeps until a sector is
+   dirtied. */
+#define DIRTY_AGE TIMER_FREQ
+#define DIRTY_RATIO 50
+#define FLUSH_POLL (TIMER_FREQ / 10)
+
+/* buffer_lock is the index lock.  It protects buffer_list,
+   buffer_hash, dirty_list, the read-ahead queue and the
+   sector_idx, pin_cnt, accessed, read_ahead, dirty and
+   dirty_since members of every element, and is only
+   held for short stretches that do not wait on other locks.
+   Each element's own lock protects its buffer, loaded and
+   should_write, so threads working on different sectors do not
+   block each other, even while one of them waits for the
+   disk. */
 static struct lock buffer_lock;
+/* Cached sectors in the order they were installed. */
 static struct list buffer_list;
-
-/* Set to -1 when there is no sector to read. */
-#define NO_READ_AHEAD_SECTOR_IDX -1
-static int read_ahead_sector_idx;
-
-static struct thread *read_ahead_thread;
+static size_t buffer_cnt;
+/* Elements whose buffers were modified as of the last time their
+   lock was released, oldest modification first. */
+static struct list dirty_list;
+static size_t dirty_cnt;
+/* The flusher waits on this, with buffer_lock, while dirty_list
+   is empty. */
+static struct condition flush_cond;
+/* Elements of allocated slabs that hold no sector. */
+static struct list free_list;
+/* Allocated slabs, oldest first. */
+static struct list slab_list;
+static size_t slab_cnt;
+
+/* Maximum number of cached sectors, a multiple of
+   SLAB_SECTOR_CNT.  Set by fs_cache_set_size(). */
+static size_t cache_size = DEFAULT_CACHE_SIZE;
+/* Cached sectors indexed by sector_idx for constant-time lookups. */
+static struct hash buffer_hash;
+
+/* Sectors waiting to be read ahead, a ring buffer protected by
+   buffer_lock.  Requests that do not fit are dropped. */
+#define READ_AHEAD_QUEUE_SIZE 128
+static block_sector_t read_ahead_queue[READ_AHEAD_QUEUE_SIZE];
+static size_t read_ahead_head;    /* Index of the oldest request. */
+static size_t read_ahead_cnt;     /* Number of queued requests. */
+
+/* Read-ahead workers wait on this, with buffer_lock, while the
+   queue is empty. */
+#define READ_AHEAD_WORKER_CNT 2
+static struct condition read_ahead_cond;
+
+/* Replacement policy, set by fs_cache_set_policy(). */
+static enum fs_cache_policy policy = FS_CACHE_CLOCK;
+
+/* Statistics. */
+static long long lookup_cnt;      /* # of find_fs_cache_elem() calls. */
+static long long compare_cnt;     /* # of sector comparisons during lookups. */
+static long long hit_cnt;         /* # of demanded sectors found cached. */
+static long long miss_cnt;        /* # of demanded sectors read from disk. */
+static long long shrink_cnt;      /* # of slabs given back by fs_cache_shrink(). */
+static long long ahead_cnt;       /* # of sectors read ahead. */
+static long long ahead_hit_cnt;   /* # of those later demanded. */
+static long long flush_cnt;       /* # of sectors written back by the flusher. */
 
 struct fs_cache_elem
   {
     block_sector_t sector_idx;
     uint8_t *buffer;
-    struct list_elem list_elem;
+    struct list_elem list_elem;   /* In buffer_list if installed,
+                                     otherwise in free_list. */
+    struct hash_elem hash_elem;
+    struct lock lock;             /* Protects buffer, loaded and should_write. */
+    int pin_cnt;                  /* # of threads holding or waiting for lock.
+                                     A pinned element is never evicted. */
+    bool loaded;                  /* Buffer holds the sector's contents. */
     bool should_write;
+    bool accessed;                /* Looked up since the clock hand last passed. */
+    bool installed;               /* Holds a sector. */
+    bool read_ahead;              /* Read ahead and not demanded yet. */
+    bool dirty;                   /* In dirty_list. */
+    struct list_elem dirty_elem;  /* Element in dirty_list. */
+    int64_t dirty_since;          /* Ticks when added to dirty_list. */
   };
 
+/* SLAB_PAGE_CNT pages of sector buffers and their elements. */
+struct fs_cache_slab
+  {
+    struct list_elem list_elem;   /* Element in slab_list. */
+    uint8_t *pages;
+    struct fs_cache_elem elems[SLAB_SECTOR_CNT];
+  };
+
+static unsigned fs_cache_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct fs_cache_elem *elem = hash_entry (e, struct fs_cache_elem, hash_elem);
+  return hash_int (elem->sector_idx);
+}
+
+static bool fs_cache_less_func (const struct hash_elem *a,
+                                const struct hash_elem *b,
+                                void *aux UNUSED)
+{
+  struct fs_cache_elem *elem_a = hash_entry (a, struct fs_cache_elem, hash_elem);
+  struct fs_cache_elem *elem_b = hash_entry (b, struct fs_cache_elem, hash_elem);
+  compare_cnt++;
+  return elem_a->sector_idx < elem_b->sector_idx;
+}
+
 struct fs_cache_elem *find_fs_cache_elem (block_sector_t sector_idx);
-struct fs_cache_elem *install_fs_cache_elem (block_sector_t sector_idx);
+struct fs_cache_elem *install_fs_cache_elem (block_sector_t sector_idx,
+                                             bool *wrote_back);
+static struct fs_cache_elem *pop_victim (void);
+static bool grow_cache (void);
+static bool over_dirty_ratio (void);
+static size_t flush_batch (uint8_t *bounce);
+static void set_dirty (struct fs_cache_elem *elem, bool dirty);
+static struct fs_cache_elem *acquire_fs_cache_elem (block_sector_t sector_idx,
+                                                    bool load);
+static void release_fs_cache_elem (struct fs_cache_elem *elem);
 
 void periodic_flusher (void *aux UNUSED);
 void ahead_reader (void *aux UNUSED);
@@ -38,15 +168,31 @@ void fs_cache_init (void)
 {
   lock_init (&buffer_lock);
   list_init (&buffer_list);
-  read_ahead_sector_idx = NO_READ_AHEAD_SECTOR_IDX;
+  buffer_cnt = 0;
+  list_init (&dirty_list);
+  dirty_cnt = 0;
+  cond_init (&flush_cond);
+  list_init (&free_list);
+  list_init (&slab_list);
+  slab_cnt = 0;
+  hash_init (&buffer_hash, &fs_cache_hash_func, &fs_cache_less_func, NULL);
+  read_ahead_head = read_ahead_cnt = 0;
+  cond_init (&read_ahead_cond);
+
+  /* The cache keeps at least one slab, even under memory
+     pressure. */
+  if (!grow_cache ())
+    PANIC ("fs_cache_init: cannot allocate buffer cache");
 
   thread_create ("fs-cache-flush", PRI_DEFAULT, periodic_flusher, NULL);
 
-  enum intr_level old_level;
-  old_level = intr_disable ();
-  tid_t read_ahead_tid = thread_create ("fs-cache-read", PRI_DEFAULT, ahead_reader, NULL);
-  read_ahead_thread = thread_find (read_ahead_tid);
-  intr_set_level (old_level);
+  int i;
+  for (i = 0; i < READ_AHEAD_WORKER_CNT; i++)
+    {
+      char name[16];
+      snprintf (name, sizeof name, "fs-cache-read%d", i);
+      thread_create (name, PRI_DEFAULT, ahead_reader, NULL);
+    }
 }
 
 void fs_cache_done (void)
@@ -61,132 +207,626 @@ void fs_cache_done (void)
       if (elem->should_write)
         block_write (fs_device, elem->sector_idx, elem->buffer);
 
-      free (elem->buffer);
-      free (elem);
+      hash_delete (&buffer_hash, &elem->hash_elem);
+    }
+  buffer_cnt = 0;
+  list_init (&dirty_list);
+  dirty_cnt = 0;
+
+  while (!list_empty (&slab_list))
+    {
+      e = list_pop_front (&slab_list);
+      struct fs_cache_slab *slab = list_entry (e, struct fs_cache_slab, list_elem);
+      palloc_free_multiple (slab->pages, SLAB_PAGE_CNT);
+      free (slab);
     }
+  list_init (&free_list);
+  slab_cnt = 0;
 
   // TODO: If needed, stop the periodic-flush and read-ahead threads.
 }
 
-struct lock *fs_cache_get_lock (void)
+/* Selects the replacement policy.  Must be called before
+   fs_cache_init(). */
+void fs_cache_set_policy (enum fs_cache_policy new_policy)
+{
+  policy = new_policy;
+}
+
+/* Sets the maximum number of cached sectors to SECTOR_CNT,
+   rounded up to a whole number of slabs.  Must be called before
+   fs_cache_init(). */
+void fs_cache_set_size (size_t sector_cnt)
 {
-  return &buffer_lock;
+  cache_size = ROUND_UP (sector_cnt > 0 ? sector_cnt : 1, SLAB_SECTOR_CNT);
 }
 
-uint8_t *fs_cache_get_buffer (block_sector_t sector_idx)
+/* Gives the newest slab whose sectors are all unpinned and clean
+   back to the user pool.  Returns false if there is no such
+   slab.  The last slab is never given back.
+
+   This is called by the frame table with its lock held, so it
+   never waits for the disk: slabs with dirty sectors are left
+   for the flusher to clean, within DIRTY_AGE ticks, and the
+   frame table evicts a page instead meanwhile.  should_write of
+   an unpinned element can be read under buffer_lock, because
+   nobody holds the lock of an unpinned element. */
+bool fs_cache_shrink (void)
 {
-  struct fs_cache_elem *elem = find_fs_cache_elem (sector_idx);
-  if (elem == NULL)
-    elem = install_fs_cache_elem (sector_idx);
+  struct fs_cache_slab *slab = NULL;
+  struct list_elem *e;
+  size_t i;
+
+  lock_acquire (&buffer_lock);
+  if (slab_cnt > 1)
+    for (e = list_rbegin (&slab_list); e != list_rend (&slab_list);
+         e = list_prev (e))
+      {
+        struct fs_cache_slab *candidate = list_entry (e, struct fs_cache_slab, list_elem);
+        for (i = 0; i < SLAB_SECTOR_CNT; i++)
+          if (candidate->elems[i].pin_cnt > 0
+              || candidate->elems[i].should_write)
+            break;
+        if (i == SLAB_SECTOR_CNT)
+          {
+            slab = candidate;
+            break;
+          }
+      }
+  if (slab == NULL)
+    {
+      lock_release (&buffer_lock);
+      return false;
+    }
 
-  return elem->buffer;
+  for (i = 0; i < SLAB_SECTOR_CNT; i++)
+    {
+      struct fs_cache_elem *elem = &slab->elems[i];
+      list_remove (&elem->list_elem);
+      if (elem->installed)
+        {
+          hash_delete (&buffer_hash, &elem->hash_elem);
+          buffer_cnt--;
+        }
+    }
+  list_remove (&slab->list_elem);
+  slab_cnt--;
+  shrink_cnt++;
+  lock_release (&buffer_lock);
+
+  palloc_free_multiple (slab->pages, SLAB_PAGE_CNT);
+  free (slab);
+  return true;
 }
 
-void fs_cache_read (block_sector_t sector_idx)
+/* Prints buffer cache statistics. */
+void fs_cache_print_stats (void)
 {
-  if (find_fs_cache_elem (sector_idx) != NULL)
-    return;
+  /* Index comparisons per lookup, in hundredths. */
+  long long per_lookup = lookup_cnt > 0 ? compare_cnt * 100 / lookup_cnt : 0;
+
+  printf ("Buffer cache (%s, %zu of %zu sectors): %lld hits, "
+          "%lld misses, %lld lookups, %lld index comparisons "
+          "(%lld.%02lld per lookup), "
+          "%lld slabs given back, %lld read ahead (%lld used), "
+          "%lld written back\n",
+          policy == FS_CACHE_CLOCK ? "clock" : "fifo",
+          slab_cnt * SLAB_SECTOR_CNT, cache_size,
+          hit_cnt, miss_cnt, lookup_cnt, compare_cnt,
+          per_lookup / 100, per_lookup % 100, shrink_cnt,
+          ahead_cnt, ahead_hit_cnt, flush_cnt);
+}
 
-  struct fs_cache_elem *elem = install_fs_cache_elem (sector_idx);
-  block_read (fs_device, sector_idx, elem->buffer);
+/* Copies SIZE bytes starting at byte OFS of sector SECTOR_IDX
+   into BUFFER, reading the sector from disk if it is not
+   cached.
+
+   BUFFER may be in user memory, and touching it may fault and
+   read a page back in through this cache.  So the entry lock is
+   never held across an access to BUFFER: the data goes through
+   a bounce buffer on the stack, and likewise in
+   fs_cache_write_at(). */
+void fs_cache_read_at (block_sector_t sector_idx, void *buffer,
+                       int ofs, int size)
+{
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  uint8_t bounce[BLOCK_SECTOR_SIZE];
+  struct fs_cache_elem *elem = acquire_fs_cache_elem (sector_idx, true);
+  memcpy (bounce, elem->buffer + ofs, size);
+  release_fs_cache_elem (elem);
+  memcpy (buffer, bounce, size);
+}
+
+/* Copies SIZE bytes from BUFFER into sector SECTOR_IDX starting
+   at byte OFS.  The sector is read from disk first unless it is
+   cached or the write covers all of it. */
+void fs_cache_write_at (block_sector_t sector_idx, const void *buffer,
+                        int ofs, int size)
+{
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  uint8_t bounce[BLOCK_SECTOR_SIZE];
+  memcpy (bounce, buffer, size);
+
+  bool whole_sector = ofs == 0 && size == BLOCK_SECTOR_SIZE;
+  struct fs_cache_elem *elem = acquire_fs_cache_elem (sector_idx, !whole_sector);
+  memcpy (elem->buffer + ofs, bounce, size);
+  elem->loaded = true;
+  elem->should_write = true;
+  release_fs_cache_elem (elem);
+}
+
+/* Fills sector SECTOR_IDX with zeros. */
+void fs_cache_zero (block_sector_t sector_idx)
+{
+  struct fs_cache_elem *elem = acquire_fs_cache_elem (sector_idx, false);
+  memset (elem->buffer, 0, BLOCK_SECTOR_SIZE);
+  elem->loaded = true;
+  elem->should_write = true;
+  release_fs_cache_elem (elem);
+}
 
-  read_ahead_sector_idx = sector_idx + 1;
-  read_ahead_thread->priority = PRI_DEFAULT;
+/* Asks for SECTOR_IDX to be read into the cache in the
+   background, unless it is already cached. */
+void fs_cache_read_ahead (block_sector_t sector_idx)
+{
+  lock_acquire (&buffer_lock);
+  if (read_ahead_cnt < READ_AHEAD_QUEUE_SIZE
+      && find_fs_cache_elem (sector_idx) == NULL)
+    {
+      size_t tail = (read_ahead_head + read_ahead_cnt) % READ_AHEAD_QUEUE_SIZE;
+      read_ahead_queue[tail] = sector_idx;
+      read_ahead_cnt++;
+      cond_signal (&read_ahead_cond, &buffer_lock);
+    }
+  lock_release (&buffer_lock);
 }
 
-void fs_cache_write (block_sector_t sector_idx)
+/* Returns the element caching SECTOR_IDX, pinned and with its
+   lock held, installing it if needed.  If LOAD is true, the
+   sector is read from disk unless it is already cached.  The
+   disk is only accessed with the element's lock held, never with
+   buffer_lock. */
+static struct fs_cache_elem *acquire_fs_cache_elem (block_sector_t sector_idx,
+                                                    bool load)
 {
-  struct fs_cache_elem *elem = find_fs_cache_elem (sector_idx);
-  if (elem == NULL)
+  struct fs_cache_elem *elem;
+
+  while (true)
+    {
+      lock_acquire (&buffer_lock);
+      elem = find_fs_cache_elem (sector_idx);
+      if (elem != NULL)
+        {
+          elem->accessed = true;
+          elem->pin_cnt++;
+          if (load)
+            hit_cnt++;
+          if (load && elem->read_ahead)
+            ahead_hit_cnt++;
+          elem->read_ahead = false;
+          lock_release (&buffer_lock);
+          lock_acquire (&elem->lock);
+          break;
+        }
+
+      bool wrote_back;
+      elem = install_fs_cache_elem (sector_idx, &wrote_back);
+      if (elem != NULL)
+        {
+          if (load)
+            miss_cnt++;
+          lock_release (&buffer_lock);
+          break;
+        }
+
+      /* Every sector is pinned.  Sleep rather than yield, so that
+         lower-priority threads holding the pins get to run. */
+      lock_release (&buffer_lock);
+      if (!wrote_back)
+        timer_sleep (1);
+    }
+
+  if (load && !elem->loaded)
     {
-      elem = install_fs_cache_elem (sector_idx);
       block_read (fs_device, sector_idx, elem->buffer);
+      elem->loaded = true;
     }
-  elem->should_write = true;
+  return elem;
 }
 
-struct fs_cache_elem *find_fs_cache_elem (block_sector_t sector_idx)
+/* Releases ELEM's lock and unpins it, moving it onto or off
+   dirty_list to match its should_write. */
+static void release_fs_cache_elem (struct fs_cache_elem *elem)
 {
-  struct list_elem *e;
+  bool dirty = elem->should_write;
+  lock_release (&elem->lock);
 
-  for (e = list_begin (&buffer_list); e != list_end (&buffer_list);
-       e = list_next (e))
+  lock_acquire (&buffer_lock);
+  set_dirty (elem, dirty);
+  elem->pin_cnt--;
+  lock_release (&buffer_lock);
+}
+
+/* Adds ELEM to dirty_list or removes it, according to DIRTY.
+   buffer_lock must be held. */
+static void set_dirty (struct fs_cache_elem *elem, bool dirty)
+{
+  if (dirty == elem->dirty)
+    return;
+
+  elem->dirty = dirty;
+  if (dirty)
     {
-      struct fs_cache_elem *elem = list_entry (e, struct fs_cache_elem, list_elem);
-      if (elem->sector_idx == sector_idx)
-        return elem;
+      elem->dirty_since = timer_ticks ();
+      list_push_back (&dirty_list, &elem->dirty_elem);
+      if (dirty_cnt++ == 0)
+        cond_signal (&flush_cond, &buffer_lock);
     }
-  return NULL;
+  else
+    {
+      list_remove (&elem->dirty_elem);
+      dirty_cnt--;
+    }
+}
+
+/* Returns a null pointer when SECTOR_IDX is not cached.
+   buffer_lock must be held. */
+struct fs_cache_elem *find_fs_cache_elem (block_sector_t sector_idx)
+{
+  struct fs_cache_elem elem_for_find;
+  elem_for_find.sector_idx = sector_idx;
+
+  lookup_cnt++;
+  struct hash_elem *hash_elem = hash_find (&buffer_hash, &elem_for_find.hash_elem);
+  if (hash_elem == NULL)
+    return NULL;
+
+  return hash_entry (hash_elem, struct fs_cache_elem, hash_elem);
 }
 
-struct fs_cache_elem *install_fs_cache_elem (block_sector_t sector_idx)
+/* Installs SECTOR_IDX, which must not be cached, and returns its
+   element pinned, with its lock held and its buffer not loaded.
+   buffer_lock must be held.
+
+   Returns a null pointer, with *WROTE_BACK false, if the cache
+   is full and every sector is pinned.  If the victim chosen is
+   dirty, it is written back instead, with buffer_lock released,
+   and a null pointer is returned with *WROTE_BACK true: the
+   caller must look SECTOR_IDX up again, since another thread
+   may have installed it, before trying again.  The victim stays
+   cached under its old sector, pinned and locked, until it is
+   on disk, so no other thread can read that sector from disk
+   before it is up to date. */
+struct fs_cache_elem *install_fs_cache_elem (block_sector_t sector_idx,
+                                             bool *wrote_back)
 {
   struct fs_cache_elem *elem;
 
-  if (list_size (&buffer_list) < MAX_BUFFER_LIST_SIZE)
+  *wrote_back = false;
+
+  /* Grow lazily.  If the user pool is exhausted, evict instead. */
+  if (list_empty (&free_list) && slab_cnt * SLAB_SECTOR_CNT < cache_size)
+    grow_cache ();
+
+  if (!list_empty (&free_list))
     {
-      elem = malloc (sizeof (*elem));
-      elem->buffer = malloc (BLOCK_SECTOR_SIZE);
-      elem->sector_idx = sector_idx;
-      elem->should_write = false;
+      elem = list_entry (list_pop_front (&free_list), struct fs_cache_elem, list_elem);
+      elem->installed = true;
+      buffer_cnt++;
+      lock_acquire (&elem->lock);
     }
   else
     {
-      struct list_elem *e = list_pop_front (&buffer_list);
-      elem = list_entry (e, struct fs_cache_elem, list_elem);
+      elem = pop_victim ();
+      if (elem == NULL)
+        return NULL;
+
+      /* The victim is unpinned, so this does not block. */
+      lock_acquire (&elem->lock);
       if (elem->should_write)
-        block_write (fs_device, elem->sector_idx, elem->buffer);
-      elem->sector_idx = sector_idx;
-      elem->should_write = false;
+        {
+          /* Put the victim back at the front of the list, where
+             it is found first next time, and write it back
+             without holding up other lookups. */
+          elem->pin_cnt++;
+          list_push_front (&buffer_list, &elem->list_elem);
+          lock_release (&buffer_lock);
+          block_write (fs_device, elem->sector_idx, elem->buffer);
+          elem->should_write = false;
+          lock_acquire (&buffer_lock);
+          set_dirty (elem, false);
+          elem->pin_cnt--;
+          lock_release (&elem->lock);
+          *wrote_back = true;
+          return NULL;
+        }
+      hash_delete (&buffer_hash, &elem->hash_elem);
+      set_dirty (elem, false);
     }
+  elem->sector_idx = sector_idx;
+  elem->pin_cnt = 1;
+  elem->loaded = false;
+  elem->should_write = false;
+  elem->read_ahead = false;
+  /* Start unaccessed so that a sector read ahead but never used
+     is the first to go. */
+  elem->accessed = false;
   list_push_back (&buffer_list, &elem->list_elem);
+  hash_insert (&buffer_hash, &elem->hash_elem);
   return elem;
 }
 
-void periodic_flusher (void *aux UNUSED)
+/* Removes the element to evict from the buffer list and returns
+   it, or returns a null pointer if every element is pinned.
+   With FS_CACHE_FIFO this is the oldest installed unpinned
+   sector.  With FS_CACHE_CLOCK the front of the list acts as the
+   clock hand: accessed sectors get their accessed bit cleared
+   and are moved to the back, and the first sector found
+   unaccessed and unpinned is evicted.  Pinned sectors are passed
+   over in both cases.  This ends after at most two sweeps of the
+   list. */
+static struct fs_cache_elem *pop_victim (void)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * buffer_cnt; i++)
+    {
+      struct list_elem *e = list_pop_front (&buffer_list);
+      struct fs_cache_elem *elem = list_entry (e, struct fs_cache_elem, list_elem);
+      if (elem->pin_cnt == 0
+          && (policy == FS_CACHE_FIFO || !elem->accessed))
+        return elem;
+
+      if (elem->pin_cnt == 0)
+        elem->accessed = false;
+      list_push_back (&buffer_list, &elem->list_elem);
+    }
+  return NULL;
+}
+
+/* Allocates a slab and adds its elements to free_list.  Returns
+   false if the user pool or the kernel heap is exhausted.
+   buffer_lock must be held, except during fs_cache_init(). */
+static bool grow_cache (void)
+{
+  struct fs_cache_slab *slab = malloc (sizeof *slab);
+  if (slab == NULL)
+    return false;
+
+  slab->pages = palloc_get_multiple (PAL_USER, SLAB_PAGE_CNT);
+  if (slab->pages == NULL)
+    {
+      free (slab);
+      return false;
+    }
+
+  size_t i;
+  for (i = 0; i < SLAB_SECTOR_CNT; i++)
+    {
+      struct fs_cache_elem *elem = &slab->elems[i];
+      elem->buffer = slab->pages + i * BLOCK_SECTOR_SIZE;
+      lock_init (&elem->lock);
+      elem->pin_cnt = 0;
+      elem->should_write = false;
+      elem->dirty = false;
+      elem->installed = false;
+      list_push_back (&free_list, &elem->list_elem);
+    }
+  list_push_back (&slab_list, &slab->list_elem);
+  slab_cnt++;
+  return true;
+}
+
+/* Returns true if more than DIRTY_RATIO percent of the cache is
+   dirty.  buffer_lock must be held. */
+static bool over_dirty_ratio (void)
 {
+  return dirty_cnt * 100 > DIRTY_RATIO * slab_cnt * SLAB_SECTOR_CNT;
+}
+
+/* Pins a batch of dirty elements that are due for write-back,
+   then writes them back in ascending sector order.  Each sector
+   is copied into BOUNCE and marked clean under its element's
+   lock, which is released before the I/O, so that threads using
+   the sector do not wait for the disk; one that writes it again
+   meanwhile marks it dirty again.  The elements stay pinned
+   until their sectors are on disk, so that none is evicted and
+   read back from disk before then.  should_write is only a hint
+   until the element's lock is held.  BOUNCE has room for
+   FLUSH_BATCH_SIZE sectors.  Returns the size of the batch. */
+static size_t flush_batch (uint8_t *bounce)
+{
+  static struct fs_cache_elem *batch[FLUSH_BATCH_SIZE];
+  static struct fs_cache_elem *written[FLUSH_BATCH_SIZE];
+  static struct block_request requests[FLUSH_BATCH_SIZE];
   struct list_elem *e;
+  size_t batch_cnt = 0;
+  size_t written_cnt, request_cnt;
+  size_t i, j;
+
+  lock_acquire (&buffer_lock);
+  bool flush_all = over_dirty_ratio ();
+  int64_t now = timer_ticks ();
+  for (e = list_begin (&dirty_list);
+       e != list_end (&dirty_list) && batch_cnt < FLUSH_BATCH_SIZE;
+       e = list_next (e))
+    {
+      struct fs_cache_elem *elem = list_entry (e, struct fs_cache_elem, dirty_elem);
+      if (!flush_all && now - elem->dirty_since < DIRTY_AGE)
+        break;
 
-  while (true)
+      elem->pin_cnt++;
+      batch[batch_cnt++] = elem;
+    }
+  lock_release (&buffer_lock);
+
+  /* Insertion sort by sector, so that adjacent sectors are
+     written one after another. */
+  for (i = 1; i < batch_cnt; i++)
     {
-      /* Run every second. */
-      timer_sleep (TIMER_FREQ);
+      struct fs_cache_elem *elem = batch[i];
+      for (j = i; j > 0 && batch[j - 1]->sector_idx > elem->sector_idx; j--)
+        batch[j] = batch[j - 1];
+      batch[j] = elem;
+    }
 
-      lock_acquire (&buffer_lock);
+  /* Lock the batch in ascending sector order, skipping elements
+     that were cleaned in the meantime, and stage runs of
+     adjacent dirty sectors as one request each. */
+  written_cnt = request_cnt = 0;
+  for (i = 0; i < batch_cnt; i++)
+    {
+      struct fs_cache_elem *elem = batch[i];
+      uint8_t *staged = bounce + written_cnt * BLOCK_SECTOR_SIZE;
 
-      for (e = list_begin (&buffer_list); e != list_end (&buffer_list);
-           e = list_next (e))
+      lock_acquire (&elem->lock);
+      if (!elem->should_write)
         {
-          struct fs_cache_elem *elem = list_entry (e, struct fs_cache_elem, list_elem);
-          if (!elem->should_write)
-            continue;
+          release_fs_cache_elem (elem);
+          continue;
+        }
 
-          block_write (fs_device, elem->sector_idx, elem->buffer);
-          elem->should_write = false;
+      memcpy (staged, elem->buffer, BLOCK_SECTOR_SIZE);
+      elem->should_write = false;
+      lock_acquire (&buffer_lock);
+      set_dirty (elem, false);
+      lock_release (&buffer_lock);
+      lock_release (&elem->lock);
+
+      if (written_cnt > 0
+          && written[written_cnt - 1]->sector_idx + 1 == elem->sector_idx)
+        requests[request_cnt - 1].cnt++;
+      else
+        block_request_init (&requests[request_cnt++], elem->sector_idx, 1,
+                            staged, true, NULL, NULL);
+      written[written_cnt++] = elem;
+    }
+
+  for (i = 0; i < request_cnt; i++)
+    block_submit (fs_device, &requests[i]);
+
+  /* Unpin each run as soon as it is on disk. */
+  j = 0;
+  for (i = 0; i < request_cnt; i++)
+    {
+      size_t end = j + requests[i].cnt;
+
+      block_wait (&requests[i]);
+      lock_acquire (&buffer_lock);
+      for (; j < end; j++)
+        {
+          written[j]->pin_cnt--;
+          flush_cnt++;
         }
+      lock_release (&buffer_lock);
+    }
+  return batch_cnt;
+}
+
+/* Write-back thread.  Sleeps until a sector is dirtied, then
+   writes back sectors as they reach DIRTY_AGE, or all of them
+   while the cache is over DIRTY_RATIO. */
+void periodic_flusher (void *aux UNUSED)
+{
+  uint8_t *bounce = palloc_get_multiple (PAL_ASSERT, FLUSH_BOUNCE_PAGES);
 
+  while (true)
+    {
+      lock_acquire (&buffer_lock);
+      while (list_empty (&dirty_list))
+        cond_wait (&flush_cond, &buffer_lock);
+      struct fs_cache_elem *oldest = list_entry (list_front (&dirty_list),
+                                                 struct fs_cache_elem, dirty_elem);
+      int64_t wait = oldest->dirty_since + DIRTY_AGE - timer_ticks ();
+      bool due = wait <= 0 || over_dirty_ratio ();
       lock_release (&buffer_lock);
+
+      if (!due)
+        timer_sleep (wait < FLUSH_POLL ? wait : FLUSH_POLL);
+      else
+        while (flush_batch (bounce) == FLUSH_BATCH_SIZE)
+          continue;
     }
 }
 
+/* Read-ahead worker.  Takes a batch of sectors off the
+   read-ahead queue, installs those that are not cached yet, and
+   reads them with one request per run of adjacent sectors,
+   sleeping while the queue is empty. */
 void ahead_reader (void *aux UNUSED)
 {
+  struct ahead_batch
+    {
+      struct fs_cache_elem *elems[READ_AHEAD_BATCH_SIZE];
+      struct block_request requests[READ_AHEAD_BATCH_SIZE];
+    };
+  struct ahead_batch *batch = malloc (sizeof *batch);
+  uint8_t *bounce = palloc_get_multiple (PAL_ASSERT, READ_AHEAD_BOUNCE_PAGES);
+
+  if (batch == NULL)
+    PANIC ("ahead_reader: out of memory");
+
   while (true)
     {
+      size_t elem_cnt = 0, request_cnt = 0;
+      size_t i, j;
+
       lock_acquire (&buffer_lock);
-      if (read_ahead_sector_idx >= 0)
+      while (read_ahead_cnt == 0)
+        cond_wait (&read_ahead_cond, &buffer_lock);
+      while (read_ahead_cnt > 0 && elem_cnt < READ_AHEAD_BATCH_SIZE)
         {
-          if (find_fs_cache_elem (read_ahead_sector_idx) == NULL)
-            {
-              struct fs_cache_elem *elem = install_fs_cache_elem (read_ahead_sector_idx);
-              block_read (fs_device, read_ahead_sector_idx, elem->buffer);
-            }
-          read_ahead_sector_idx = NO_READ_AHEAD_SECTOR_IDX;
+          block_sector_t sector_idx = read_ahead_queue[read_ahead_head];
+          struct fs_cache_elem *elem;
+
+          read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_QUEUE_SIZE;
+          read_ahead_cnt--;
+          if (sector_idx >= block_size (fs_device))
+            continue;
+
+          /* Installing may write back a dirty victim and then has
+             to look the sector up again. */
+          bool wrote_back = true;
+          elem = NULL;
+          while (elem == NULL && wrote_back
+                 && find_fs_cache_elem (sector_idx) == NULL)
+            elem = install_fs_cache_elem (sector_idx, &wrote_back);
+          if (elem == NULL && !wrote_back)
+            break;
+          if (elem == NULL)
+            continue;
+          elem->read_ahead = true;
+
+          if (elem_cnt > 0
+              && batch->elems[elem_cnt - 1]->sector_idx + 1 == sector_idx)
+            batch->requests[request_cnt - 1].cnt++;
+          else
+            block_request_init (&batch->requests[request_cnt++], sector_idx, 1,
+                                bounce + elem_cnt * BLOCK_SECTOR_SIZE, false,
+                                NULL, NULL);
+          batch->elems[elem_cnt++] = elem;
         }
+      ahead_cnt += elem_cnt;
       lock_release (&buffer_lock);
 
-      thread_set_priority (PRI_MIN);
-      thread_yield ();
-    }
+      for (i = 0; i < request_cnt; i++)
+        block_submit (fs_device, &batch->requests[i]);
+
+      j = 0;
+      for (i = 0; i < request_cnt; i++)
+        {
+          size_t end = j + batch->requests[i].cnt;
 
+          block_wait (&batch->requests[i]);
+          for (; j < end; j++)
+            {
+              memcpy (batch->elems[j]->buffer, bounce + j * BLOCK_SECTOR_SIZE,
+                      BLOCK_SECTOR_SIZE);
+              batch->elems[j]->loaded = true;
+              release_fs_cache_elem (batch->elems[j]);
+            }
+        }
+    }
 }
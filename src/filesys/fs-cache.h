@@ -1,14 +1,29 @@
 #ifndef FILESYS_FS_CACHE_H
 #define FILESYS_FS_CACHE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "devices/block.h"
 
+/* Buffer cache replacement policies. */
+enum fs_cache_policy
+  {
+    FS_CACHE_FIFO,              /* Evict the oldest installed sector. */
+    FS_CACHE_CLOCK              /* Second chance for accessed sectors. */
+  };
+
+void fs_cache_set_policy (enum fs_cache_policy);
+void fs_cache_set_size (size_t sector_cnt);
 void fs_cache_init (void);
 void fs_cache_done (void);
-struct lock *fs_cache_get_lock (void);
-uint8_t *fs_cache_get_buffer (block_sector_t sector_idx);
-void fs_cache_read (block_sector_t sector_idx);
-void fs_cache_write (block_sector_t sector_idx);
+bool fs_cache_shrink (void);
+void fs_cache_print_stats (void);
+void fs_cache_read_at (block_sector_t sector_idx, void *buffer,
+                       int ofs, int size);
+void fs_cache_write_at (block_sector_t sector_idx, const void *buffer,
+                        int ofs, int size);
+void fs_cache_zero (block_sector_t sector_idx);
+void fs_cache_read_ahead (block_sector_t sector_idx);
 
 #endif /* filesys/fs-cache.h */
@@ -2,6 +2,7 @@
 #include <list.h>
 #include <debug.h>
 #include <math.h>
+#include <round.h>
 #include <string.h>
 #include "filesys/directory.h"
 #include "filesys/fs-cache.h"
@@ -9,7 +10,6 @@
 #include "filesys/inode_data.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
-#include "threads/thread.h"
 
 /* In-memory inode. */
 struct inode 
@@ -22,21 +22,31 @@ struct inode
     struct inode_data *data;             /* Inode content. */
   };
 
+/* Bounds of the read-ahead window, in sectors. */
+#define MIN_READ_AHEAD 2
+#define MAX_READ_AHEAD 32
+
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
 
-/* A temporary variable to prevent crashing while creating inodes. */
-static tid_t inode_creating_thread;
-static tid_t inode_data_extending_thread;
+/* Serializes inode creation and growth, which allocate sectors
+   from the free map.  Reads and in-place writes take it only
+   briefly, through locate_sector(), to look up a sector; the
+   data itself is synchronized per sector by the buffer cache.
+   The free map file is written from within free_map_allocate()
+   while extend_lock is already held. */
+static struct lock extend_lock;
+
+static block_sector_t locate_sector (struct inode *, off_t pos,
+                                     off_t *length);
 
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
   list_init (&open_inodes);
-  inode_creating_thread = TID_ERROR;
-  inode_data_extending_thread = TID_ERROR;
+  lock_init (&extend_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -51,11 +61,9 @@ inode_create (block_sector_t sector, off_t length)
 
   ASSERT (length >= 0);
 
-  lock_acquire (fs_cache_get_lock ());
-  inode_creating_thread = thread_tid ();
+  lock_acquire (&extend_lock);
   success = inode_data_create (sector, length);
-  inode_creating_thread = TID_ERROR;
-  lock_release (fs_cache_get_lock ());
+  lock_release (&extend_lock);
   return success;
 }
 
@@ -170,15 +178,15 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
 
-  lock_acquire (fs_cache_get_lock ());
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = inode_data_sector (inode->data, offset);
+      off_t length;
+      block_sector_t sector_idx = locate_sector (inode, offset, &length);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = length - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = MIN(inode_left, sector_left);
 
@@ -187,15 +195,66 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      fs_cache_read (sector_idx);
-      memcpy (buffer + bytes_read, fs_cache_get_buffer (sector_idx) + sector_ofs, chunk_size);
+      fs_cache_read_at (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  lock_release (fs_cache_get_lock ());
+
+  return bytes_read;
+}
+
+/* Initializes STREAM for a newly opened file. */
+void
+inode_stream_init (struct inode_stream *stream)
+{
+  stream->next_ofs = 0;
+  stream->window = 0;
+  stream->ahead_idx = 0;
+}
+
+/* Reads like inode_read_at() and records the read in STREAM.
+   A read that starts where the previous one ended is sequential:
+   it doubles the read-ahead window, from MIN_READ_AHEAD up to
+   MAX_READ_AHEAD sectors, and the sectors of INODE that follow,
+   up to the window, are handed to the buffer cache to read in
+   the background.  Any other read collapses the window. */
+off_t
+inode_read_stream (struct inode *inode, struct inode_stream *stream,
+                   void *buffer, off_t size, off_t offset)
+{
+  off_t bytes_read = inode_read_at (inode, buffer, size, offset);
+
+  if (offset == stream->next_ofs)
+    stream->window = (stream->window == 0
+                      ? MIN_READ_AHEAD
+                      : MIN (stream->window * 2, MAX_READ_AHEAD));
+  else
+    {
+      stream->window = 0;
+      stream->ahead_idx = 0;
+    }
+  stream->next_ofs = offset + bytes_read;
+
+  if (stream->window > 0)
+    {
+      size_t next_idx = stream->next_ofs / BLOCK_SECTOR_SIZE;
+      off_t length;
+      size_t sector_cnt, end_idx, idx;
+
+      locate_sector (inode, 0, &length);
+      sector_cnt = DIV_ROUND_UP (length, BLOCK_SECTOR_SIZE);
+      end_idx = MIN (next_idx + stream->window, sector_cnt);
+      if (stream->ahead_idx < next_idx)
+        stream->ahead_idx = next_idx;
+      for (idx = stream->ahead_idx; idx < end_idx; idx++)
+        fs_cache_read_ahead (locate_sector (inode, idx * BLOCK_SECTOR_SIZE,
+                                            &length));
+      if (end_idx > stream->ahead_idx)
+        stream->ahead_idx = end_idx;
+    }
 
   return bytes_read;
 }
@@ -217,25 +276,23 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
   if (inode->deny_write_cnt)
     return 0;
 
-  bool rightfully_already_locked = inode_creating_thread == thread_tid () || inode_data_extending_thread == thread_tid ();
-  if (!rightfully_already_locked)
-    lock_acquire (fs_cache_get_lock ());
-
   if (inode_length (inode) < (offset + size))
     {
-      inode_data_extending_thread = thread_tid ();
-      inode_data_extend (inode->data, offset + size - inode_length (inode));
-      inode_data_extending_thread = TID_ERROR;
+      lock_acquire (&extend_lock);
+      if (inode_length (inode) < (offset + size))
+        inode_data_extend (inode->data, offset + size - inode_length (inode));
+      lock_release (&extend_lock);
     }
 
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = inode_data_sector (inode->data, offset);
+      off_t length;
+      block_sector_t sector_idx = locate_sector (inode, offset, &length);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = length - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
 
       int min_left = MIN(inode_left, sector_left);
@@ -245,23 +302,15 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      /* If the sector contains data before or after the chunk
-          we're writing, then we need to read in the sector
-          first.  Otherwise we start with a sector of all zeros. */
-      if (sector_ofs > 0 || chunk_size < sector_left)
-        fs_cache_read (sector_idx);
-      else
-        memset (fs_cache_get_buffer (sector_idx), 0, BLOCK_SECTOR_SIZE);
-      memcpy (fs_cache_get_buffer (sector_idx) + sector_ofs, buffer + bytes_written, chunk_size);
-      fs_cache_write (sector_idx);
+      /* The cache reads in the sector first unless the chunk
+         covers all of it. */
+      fs_cache_write_at (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  if (!rightfully_already_locked)
-    lock_release (fs_cache_get_lock ());
 
   return bytes_written;
 }
@@ -286,6 +335,27 @@ inode_allow_write (struct inode *inode)
   inode->deny_write_cnt--;
 }
 
+/* Returns the sector of INODE that contains byte offset POS, or
+   -1 if INODE has no data at POS, and stores INODE's length in
+   *LENGTH.  Both are read under extend_lock, so that they are
+   consistent with each other and not torn by a concurrent
+   inode_data_extend().  The caller may already hold extend_lock,
+   when writing the free map during an extension. */
+static block_sector_t
+locate_sector (struct inode *inode, off_t pos, off_t *length)
+{
+  bool held = lock_held_by_current_thread (&extend_lock);
+  block_sector_t sector;
+
+  if (!held)
+    lock_acquire (&extend_lock);
+  *length = inode_length (inode);
+  sector = inode_data_sector (inode->data, pos);
+  if (!held)
+    lock_release (&extend_lock);
+  return sector;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -2,11 +2,21 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
 
+/* Tracks the reads made through one open file to detect
+   sequential access, for read-ahead. */
+struct inode_stream
+  {
+    off_t next_ofs;             /* Offset a sequential read starts at. */
+    size_t window;              /* Sectors to read ahead, 0 if random. */
+    size_t ahead_idx;           /* First logical sector not yet read ahead. */
+  };
+
 void inode_init (void);
 bool inode_create (block_sector_t, off_t);
 struct inode *inode_open (block_sector_t);
@@ -15,6 +25,9 @@ block_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+void inode_stream_init (struct inode_stream *);
+off_t inode_read_stream (struct inode *, struct inode_stream *,
+                         void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
@@ -5,7 +5,6 @@
 #include "filesys/fs-cache.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
-#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -69,8 +68,6 @@ void write_inode_data_disks (struct inode_data *inode_data, block_sector_t direc
 bool
 inode_data_create (block_sector_t sector, off_t length)
 {
-  ASSERT (lock_held_by_current_thread (fs_cache_get_lock ()));
-
   struct inode_data *inode_data = calloc (1, sizeof *inode_data);
   if (inode_data == NULL)
     return false;
@@ -98,8 +95,6 @@ inode_data_create (block_sector_t sector, off_t length)
 
 bool allocate_inode_data_disks (struct inode_data *inode_data, off_t length)
 {
-  ASSERT (lock_held_by_current_thread (fs_cache_get_lock ()));
-
   struct inode_sector_counts sector_counts = bytes_to_sector_counts (length);
   inode_data->direct_inode_disk.length = length;
   inode_data->direct_inode_disk.indirect_sector = INVALID_SECTOR;
@@ -160,17 +155,13 @@ bool allocate_inode_data_disks (struct inode_data *inode_data, off_t length)
 
 void write_inode_data_disks (struct inode_data *inode_data, block_sector_t direct_sector, off_t length)
 {
-  ASSERT (lock_held_by_current_thread (fs_cache_get_lock ()));
-
   struct inode_sector_counts sector_counts = bytes_to_sector_counts (length);
-  memcpy (fs_cache_get_buffer (direct_sector), &inode_data->direct_inode_disk, BLOCK_SECTOR_SIZE);
-  fs_cache_write (direct_sector);
+  fs_cache_write_at (direct_sector, &inode_data->direct_inode_disk, 0, BLOCK_SECTOR_SIZE);
 
   for (size_t i = 0; i < sector_counts.direct_sector_count; i++)
     {
       block_sector_t sector = inode_data->direct_inode_disk.sectors[i];
-      memset (fs_cache_get_buffer (sector), 0, BLOCK_SECTOR_SIZE);
-      fs_cache_write (sector);
+      fs_cache_zero (sector);
     }
 
   if (sector_counts.indirect_sector_count > 0)
@@ -178,13 +169,11 @@ void write_inode_data_disks (struct inode_data *inode_data, block_sector_t direc
       ASSERT (inode_data->direct_inode_disk.indirect_sector != INVALID_SECTOR);
 
       block_sector_t indirect_sector = inode_data->direct_inode_disk.indirect_sector;
-      memcpy (fs_cache_get_buffer (indirect_sector), &inode_data->indirect_inode_disk, BLOCK_SECTOR_SIZE);
-      fs_cache_write (indirect_sector);
+      fs_cache_write_at (indirect_sector, &inode_data->indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
       for (size_t i = 0; i < sector_counts.indirect_sector_count; i++)
         {
           block_sector_t sector = inode_data->indirect_inode_disk.sectors[i];
-          memset (fs_cache_get_buffer (sector), 0, BLOCK_SECTOR_SIZE);
-          fs_cache_write (sector);
+          fs_cache_zero (sector);
         }
     }
 
@@ -193,23 +182,20 @@ void write_inode_data_disks (struct inode_data *inode_data, block_sector_t direc
       ASSERT (inode_data->direct_inode_disk.parent_doubly_indirect_sector != INVALID_SECTOR);
 
       block_sector_t parent_doubly_indrect_sector = inode_data->direct_inode_disk.parent_doubly_indirect_sector;
-      memcpy (fs_cache_get_buffer (parent_doubly_indrect_sector), &inode_data->parent_doubly_indirect_inode_disk, BLOCK_SECTOR_SIZE);
-      fs_cache_write (parent_doubly_indrect_sector);
+      fs_cache_write_at (parent_doubly_indrect_sector, &inode_data->parent_doubly_indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
 
       size_t parent_sector_index = 0;
       size_t left_children_sector_count = sector_counts.doubly_indirect_sector_count;
       while (left_children_sector_count > 0)
         {
           block_sector_t child_doubly_indrect_sector = inode_data->parent_doubly_indirect_inode_disk.sectors[parent_sector_index];
-          memcpy (fs_cache_get_buffer (child_doubly_indrect_sector), &inode_data->children_doubly_indirect_inode_disk[parent_sector_index], BLOCK_SECTOR_SIZE);
-          fs_cache_write (child_doubly_indrect_sector);
+          fs_cache_write_at (child_doubly_indrect_sector, &inode_data->children_doubly_indirect_inode_disk[parent_sector_index], 0, BLOCK_SECTOR_SIZE);
 
           size_t child_sector_count = MIN(left_children_sector_count, INODE_DISK_MAX_SECTOR_COUNT);
           for (size_t i = 0; i < child_sector_count; i++)
             {
               block_sector_t sector = inode_data->children_doubly_indirect_inode_disk[parent_sector_index]->sectors[i];
-              memset (fs_cache_get_buffer (sector), 0, BLOCK_SECTOR_SIZE);
-              fs_cache_write (sector);
+              fs_cache_zero (sector);
             }
 
           parent_sector_index++;
@@ -225,10 +211,7 @@ inode_data_open (block_sector_t sector)
   if (inode_data == NULL)
     return NULL;
 
-  lock_acquire (fs_cache_get_lock ());
-
-  fs_cache_read (sector);
-  memcpy (&inode_data->direct_inode_disk, fs_cache_get_buffer (sector), BLOCK_SECTOR_SIZE);
+  fs_cache_read_at (sector, &inode_data->direct_inode_disk, 0, BLOCK_SECTOR_SIZE);
   ASSERT (inode_data->direct_inode_disk.magic == INODE_MAGIC);
 
   struct inode_sector_counts sector_counts = bytes_to_sector_counts (inode_data->direct_inode_disk.length);
@@ -237,8 +220,7 @@ inode_data_open (block_sector_t sector)
       block_sector_t indirect_sector = inode_data->direct_inode_disk.indirect_sector;
       ASSERT (indirect_sector != INVALID_SECTOR);
 
-      fs_cache_read (indirect_sector);
-      memcpy (&inode_data->indirect_inode_disk, fs_cache_get_buffer (indirect_sector), BLOCK_SECTOR_SIZE);
+      fs_cache_read_at (indirect_sector, &inode_data->indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
       ASSERT (inode_data->indirect_inode_disk.magic == INODE_MAGIC);
     }
 
@@ -247,8 +229,7 @@ inode_data_open (block_sector_t sector)
       block_sector_t parent_doubly_indirect_sector = inode_data->direct_inode_disk.parent_doubly_indirect_sector;
       ASSERT (parent_doubly_indirect_sector != INVALID_SECTOR);
 
-      fs_cache_read (parent_doubly_indirect_sector);
-      memcpy (&inode_data->parent_doubly_indirect_inode_disk, fs_cache_get_buffer (parent_doubly_indirect_sector), BLOCK_SECTOR_SIZE);
+      fs_cache_read_at (parent_doubly_indirect_sector, &inode_data->parent_doubly_indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
       ASSERT (inode_data->parent_doubly_indirect_inode_disk.magic == INODE_MAGIC);
 
       size_t parent_sector_index = 0;
@@ -256,8 +237,7 @@ inode_data_open (block_sector_t sector)
       while (left_children_sector_count > 0)
         {
           block_sector_t child_doubly_indrect_sector = inode_data->parent_doubly_indirect_inode_disk.sectors[parent_sector_index];
-          fs_cache_read (child_doubly_indrect_sector);
-          memcpy (&inode_data->children_doubly_indirect_inode_disk[parent_sector_index], fs_cache_get_buffer (child_doubly_indrect_sector), BLOCK_SECTOR_SIZE);
+          fs_cache_read_at (child_doubly_indrect_sector, &inode_data->children_doubly_indirect_inode_disk[parent_sector_index], 0, BLOCK_SECTOR_SIZE);
           ASSERT (inode_data->children_doubly_indirect_inode_disk[parent_sector_index]->magic == INODE_MAGIC);
 
           size_t child_sector_count = MIN(left_children_sector_count, INODE_DISK_MAX_SECTOR_COUNT);
@@ -266,8 +246,6 @@ inode_data_open (block_sector_t sector)
         }
     }
 
-  lock_release (fs_cache_get_lock ());
-
   return inode_data;
 }
 
@@ -315,8 +293,7 @@ inode_data_extend (struct inode_data *inode_data, off_t length)
         return false;
 
       inode_data->direct_inode_disk.sectors[current_sector_counts.direct_sector_count + i] = sector;
-      memset (fs_cache_get_buffer (sector), 0, BLOCK_SECTOR_SIZE);
-      fs_cache_write (sector);
+      fs_cache_zero (sector);
     }
 
   if (target_sector_counts.indirect_sector_count > 0 && current_sector_counts.indirect_sector_count == 0)
@@ -327,8 +304,7 @@ inode_data_extend (struct inode_data *inode_data, off_t length)
 
       inode_data->direct_inode_disk.indirect_sector = sector;
       inode_data->indirect_inode_disk.magic = INODE_MAGIC;
-      memcpy (fs_cache_get_buffer (sector), &inode_data->indirect_inode_disk, BLOCK_SECTOR_SIZE);
-      fs_cache_write (sector);
+      fs_cache_write_at (sector, &inode_data->indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
     }
 
   size_t indirect_sector_count_diff = target_sector_counts.indirect_sector_count - current_sector_counts.indirect_sector_count;
@@ -339,8 +315,7 @@ inode_data_extend (struct inode_data *inode_data, off_t length)
         return false;
 
       inode_data->indirect_inode_disk.sectors[current_sector_counts.indirect_sector_count + i] = sector;
-      memset (fs_cache_get_buffer (sector), 0, BLOCK_SECTOR_SIZE);
-      fs_cache_write (sector);
+      fs_cache_zero (sector);
     }
 
   if (target_sector_counts.doubly_indirect_sector_count > 0 && current_sector_counts.doubly_indirect_sector_count == 0)
@@ -351,8 +326,7 @@ inode_data_extend (struct inode_data *inode_data, off_t length)
 
       inode_data->direct_inode_disk.parent_doubly_indirect_sector = sector;
       inode_data->parent_doubly_indirect_inode_disk.magic = INODE_MAGIC;
-      memcpy (fs_cache_get_buffer (sector), &inode_data->parent_doubly_indirect_inode_disk, BLOCK_SECTOR_SIZE);
-      fs_cache_write (sector);
+      fs_cache_write_at (sector, &inode_data->parent_doubly_indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
     }
   
   for (size_t doubly_indirect_sector_index = current_sector_counts.doubly_indirect_sector_count;
@@ -371,8 +345,7 @@ inode_data_extend (struct inode_data *inode_data, off_t length)
           inode_data->parent_doubly_indirect_inode_disk.sectors[parent_index] = sector;
           inode_data->children_doubly_indirect_inode_disk[parent_index] = malloc (sizeof (struct indirect_inode_disk));
           inode_data->children_doubly_indirect_inode_disk[parent_index]->magic = INODE_MAGIC;
-          memcpy (fs_cache_get_buffer (sector), &inode_data->children_doubly_indirect_inode_disk[parent_index], BLOCK_SECTOR_SIZE);
-          fs_cache_write (sector);
+          fs_cache_write_at (sector, &inode_data->children_doubly_indirect_inode_disk[parent_index], 0, BLOCK_SECTOR_SIZE);
         }
       
       block_sector_t sector;
@@ -380,8 +353,7 @@ inode_data_extend (struct inode_data *inode_data, off_t length)
         return false;
 
       inode_data->children_doubly_indirect_inode_disk[parent_index]->sectors[child_index] = sector;
-      memcpy (fs_cache_get_buffer (sector), &inode_data->children_doubly_indirect_inode_disk[parent_index]->sectors[child_index], BLOCK_SECTOR_SIZE);
-      fs_cache_write (sector);
+      fs_cache_write_at (sector, &inode_data->children_doubly_indirect_inode_disk[parent_index]->sectors[child_index], 0, BLOCK_SECTOR_SIZE);
     }
 
   inode_data->direct_inode_disk.length += length;
@@ -391,36 +363,28 @@ inode_data_extend (struct inode_data *inode_data, off_t length)
 void
 inode_data_flush (struct inode_data *inode_data, block_sector_t sector)
 {
-  lock_acquire (fs_cache_get_lock ());
-
   struct inode_sector_counts sector_counts = bytes_to_sector_counts (inode_data->direct_inode_disk.length);
 
-  memcpy (fs_cache_get_buffer (sector), &inode_data->direct_inode_disk, BLOCK_SECTOR_SIZE);
-  fs_cache_write (sector);
+  fs_cache_write_at (sector, &inode_data->direct_inode_disk, 0, BLOCK_SECTOR_SIZE);
 
   if (sector_counts.indirect_sector_count > 0)
     {
       size_t indirect_sector = inode_data->direct_inode_disk.indirect_sector;
-      memcpy (fs_cache_get_buffer (indirect_sector), &inode_data->indirect_inode_disk, BLOCK_SECTOR_SIZE);
-      fs_cache_write (indirect_sector);
+      fs_cache_write_at (indirect_sector, &inode_data->indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
     }
 
   if (sector_counts.doubly_indirect_sector_count > 0)
     {
       size_t parent_doubly_indirect_sector = inode_data->direct_inode_disk.parent_doubly_indirect_sector;
-      memcpy (fs_cache_get_buffer (parent_doubly_indirect_sector), &inode_data->parent_doubly_indirect_inode_disk, BLOCK_SECTOR_SIZE);
-      fs_cache_write (parent_doubly_indirect_sector);
+      fs_cache_write_at (parent_doubly_indirect_sector, &inode_data->parent_doubly_indirect_inode_disk, 0, BLOCK_SECTOR_SIZE);
 
       size_t parent_doubly_indirect_sector_count = DIV_ROUND_UP(sector_counts.doubly_indirect_sector_count, INODE_DISK_MAX_SECTOR_COUNT);
       for (size_t i = 0; i <parent_doubly_indirect_sector_count; i++)
         {
           size_t sector = inode_data->parent_doubly_indirect_inode_disk.sectors[i];
-          memcpy (fs_cache_get_buffer (sector), &inode_data->children_doubly_indirect_inode_disk[i], BLOCK_SECTOR_SIZE);
-          fs_cache_write (sector);
+          fs_cache_write_at (sector, &inode_data->children_doubly_indirect_inode_disk[i], 0, BLOCK_SECTOR_SIZE);
         }
     }
-
-  lock_release (fs_cache_get_lock ());
 }
 
 off_t
@@ -0,0 +1,22 @@
+#ifndef __LIB_PROCSTAT_H
+#define __LIB_PROCSTAT_H
+
+/* Per-thread statistics returned by the procstat() system call.
+   Shared between the kernel and user programs. */
+struct procstat
+  {
+    int pid;                            /* Thread identifier. */
+    char name[16];                      /* Thread name. */
+    char state;                         /* 'R'unning, r'E'ady, 'B'locked. */
+    int priority;                       /* Priority, with donations. */
+    long long user_ticks;               /* Timer ticks in user mode. */
+    long long kernel_ticks;             /* Timer ticks in kernel mode. */
+    unsigned voluntary_switches;        /* # of times it blocked. */
+    unsigned involuntary_switches;      /* # of times it was preempted. */
+    unsigned page_faults;               /* # of page faults. */
+    unsigned resident_pages;            /* User pages in memory. */
+    long long bytes_read;               /* Bytes read from files. */
+    long long bytes_written;            /* Bytes written to files. */
+  };
+
+#endif /* lib/procstat.h */
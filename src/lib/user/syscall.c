@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+procstat (struct procstat *stats, int max) 
+{
+  return syscall2 (SYS_PROCSTAT, stats, max);
+}
@@ -0,0 +1,10 @@
+/* Runs the cache-lookup workload with a 4096-sector buffer
+   cache over an 8192-sector (4 MB) file, which needs the larger
+   file system disk and memory set in Make.tests: the cache takes
+   its pages from the user pool, which with the default 4 MB of
+   memory could not hold 4096 sectors.  With eight times as many
+   cached sectors as cache-lookup-512, a lookup should still cost
+   the same few index comparisons. */
+
+#define SECTOR_CNT 8192
+#include "tests/filesys/base/cache-lookup.inc"
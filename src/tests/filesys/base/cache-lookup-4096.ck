@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-lookup-4096) begin
+(cache-lookup-4096) create "bench"
+(cache-lookup-4096) open "bench"
+(cache-lookup-4096) writing "bench"
+(cache-lookup-4096) close "bench"
+(cache-lookup-4096) open "bench" for verification
+(cache-lookup-4096) verified contents of "bench"
+(cache-lookup-4096) close "bench"
+(cache-lookup-4096) open "bench" for verification
+(cache-lookup-4096) verified contents of "bench"
+(cache-lookup-4096) close "bench"
+(cache-lookup-4096) open "bench" for verification
+(cache-lookup-4096) verified contents of "bench"
+(cache-lookup-4096) close "bench"
+(cache-lookup-4096) open "bench" for verification
+(cache-lookup-4096) verified contents of "bench"
+(cache-lookup-4096) close "bench"
+(cache-lookup-4096) open "bench" for verification
+(cache-lookup-4096) verified contents of "bench"
+(cache-lookup-4096) close "bench"
+(cache-lookup-4096) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+/* Runs the cache-lookup workload with a 512-sector buffer cache,
+   set with -fs-cache in Make.tests, over a 1024-sector file.
+   The cache fills and evicts as with the default size, so the
+   index comparisons per lookup can be compared directly with
+   cache-lookup's; they should not grow with the cache. */
+
+#define SECTOR_CNT 1024
+#include "tests/filesys/base/cache-lookup.inc"
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-lookup-512) begin
+(cache-lookup-512) create "bench"
+(cache-lookup-512) open "bench"
+(cache-lookup-512) writing "bench"
+(cache-lookup-512) close "bench"
+(cache-lookup-512) open "bench" for verification
+(cache-lookup-512) verified contents of "bench"
+(cache-lookup-512) close "bench"
+(cache-lookup-512) open "bench" for verification
+(cache-lookup-512) verified contents of "bench"
+(cache-lookup-512) close "bench"
+(cache-lookup-512) open "bench" for verification
+(cache-lookup-512) verified contents of "bench"
+(cache-lookup-512) close "bench"
+(cache-lookup-512) open "bench" for verification
+(cache-lookup-512) verified contents of "bench"
+(cache-lookup-512) close "bench"
+(cache-lookup-512) open "bench" for verification
+(cache-lookup-512) verified contents of "bench"
+(cache-lookup-512) close "bench"
+(cache-lookup-512) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+/* Writes a 300-sector file, several times larger than the
+   default 64-sector buffer cache, and reads it back a few times,
+   one sector at a time.  Every read goes through a buffer cache
+   lookup, and most of them miss, so the "Buffer cache" line
+   printed at shutdown gives the index comparisons per lookup
+   with the cache always full and turning over. */
+
+#define SECTOR_CNT 300
+#include "tests/filesys/base/cache-lookup.inc"
@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cache-lookup) begin
+(cache-lookup) create "bench"
+(cache-lookup) open "bench"
+(cache-lookup) writing "bench"
+(cache-lookup) close "bench"
+(cache-lookup) open "bench" for verification
+(cache-lookup) verified contents of "bench"
+(cache-lookup) close "bench"
+(cache-lookup) open "bench" for verification
+(cache-lookup) verified contents of "bench"
+(cache-lookup) close "bench"
+(cache-lookup) open "bench" for verification
+(cache-lookup) verified contents of "bench"
+(cache-lookup) close "bench"
+(cache-lookup) open "bench" for verification
+(cache-lookup) verified contents of "bench"
+(cache-lookup) close "bench"
+(cache-lookup) open "bench" for verification
+(cache-lookup) verified contents of "bench"
+(cache-lookup) close "bench"
+(cache-lookup) end
+EOF
+pass;
@@ -0,0 +1,43 @@
+/* Child process for par-read test.
+   Reads file "data<N>" a sector at a time and makes sure that
+   its contents are what they should be. */
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/base/par-read.h"
+
+static char buf[BUF_SIZE];
+
+int
+main (int argc, const char *argv[]) 
+{
+  char file_name[16];
+  char block[BLOCK_SIZE];
+  int child_idx;
+  int fd;
+  size_t ofs;
+
+  test_name = "child-par-read";
+  quiet = true;
+  
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  child_idx = atoi (argv[1]);
+
+  random_init (child_idx);
+  random_bytes (buf, sizeof buf);
+
+  snprintf (file_name, sizeof file_name, "data%d", child_idx);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  for (ofs = 0; ofs < sizeof buf; ofs += BLOCK_SIZE) 
+    {
+      CHECK (read (fd, block, BLOCK_SIZE) == BLOCK_SIZE,
+             "read \"%s\"", file_name);
+      compare_bytes (block, buf + ofs, BLOCK_SIZE, ofs, file_name);
+    }
+  close (fd);
+
+  return child_idx;
+}
@@ -0,0 +1,5 @@
+/* Runs the par-read workload with the C-LOOK elevator, set with
+   -io-sched in Make.tests, so that the children's interleaved
+   misses are served in ascending sector order. */
+
+#include "tests/filesys/base/par-read.inc"
@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(par-read-clook) begin
+(par-read-clook) create "data0"
+(par-read-clook) open "data0"
+(par-read-clook) write "data0"
+(par-read-clook) close "data0"
+(par-read-clook) create "data1"
+(par-read-clook) open "data1"
+(par-read-clook) write "data1"
+(par-read-clook) close "data1"
+(par-read-clook) create "data2"
+(par-read-clook) open "data2"
+(par-read-clook) write "data2"
+(par-read-clook) close "data2"
+(par-read-clook) create "data3"
+(par-read-clook) open "data3"
+(par-read-clook) write "data3"
+(par-read-clook) close "data3"
+(par-read-clook) exec child 1 of 4: "child-par-read 0"
+(par-read-clook) exec child 2 of 4: "child-par-read 1"
+(par-read-clook) exec child 3 of 4: "child-par-read 2"
+(par-read-clook) exec child 4 of 4: "child-par-read 3"
+(par-read-clook) wait for child 1 of 4 returned 0 (expected 0)
+(par-read-clook) wait for child 2 of 4 returned 1 (expected 1)
+(par-read-clook) wait for child 3 of 4 returned 2 (expected 2)
+(par-read-clook) wait for child 4 of 4 returned 3 (expected 3)
+(par-read-clook) end
+EOF
+pass;
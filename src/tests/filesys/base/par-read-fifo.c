@@ -0,0 +1,6 @@
+/* Runs the par-read workload with requests served in arrival
+   order, set with -io-sched in Make.tests.  Compare the disk
+   queue latencies reported at shutdown with par-read-clook and
+   with par-read, which uses the default deadline scheduler. */
+
+#include "tests/filesys/base/par-read.inc"
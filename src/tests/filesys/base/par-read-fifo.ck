@@ -0,0 +1,33 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(par-read-fifo) begin
+(par-read-fifo) create "data0"
+(par-read-fifo) open "data0"
+(par-read-fifo) write "data0"
+(par-read-fifo) close "data0"
+(par-read-fifo) create "data1"
+(par-read-fifo) open "data1"
+(par-read-fifo) write "data1"
+(par-read-fifo) close "data1"
+(par-read-fifo) create "data2"
+(par-read-fifo) open "data2"
+(par-read-fifo) write "data2"
+(par-read-fifo) close "data2"
+(par-read-fifo) create "data3"
+(par-read-fifo) open "data3"
+(par-read-fifo) write "data3"
+(par-read-fifo) close "data3"
+(par-read-fifo) exec child 1 of 4: "child-par-read 0"
+(par-read-fifo) exec child 2 of 4: "child-par-read 1"
+(par-read-fifo) exec child 3 of 4: "child-par-read 2"
+(par-read-fifo) exec child 4 of 4: "child-par-read 3"
+(par-read-fifo) wait for child 1 of 4 returned 0 (expected 0)
+(par-read-fifo) wait for child 2 of 4 returned 1 (expected 1)
+(par-read-fifo) wait for child 3 of 4 returned 2 (expected 2)
+(par-read-fifo) wait for child 4 of 4 returned 3 (expected 3)
+(par-read-fifo) end
+EOF
+pass;
@@ -0,0 +1,9 @@
+/* Spawns 4 child processes, each of which reads its own file
+   sequentially, a sector at a time.  Together the files are
+   much larger than the buffer cache, so the children keep
+   missing on different sectors at the same time.  With per-entry
+   locking in the buffer cache their disk waits overlap instead
+   of queueing behind a single cache lock; compare the timer
+   ticks reported at shutdown to measure it. */
+
+#include "tests/filesys/base/par-read.inc"
@@ -0,0 +1,8 @@
+#ifndef TESTS_FILESYS_BASE_PAR_READ_H
+#define TESTS_FILESYS_BASE_PAR_READ_H
+
+#define CHILD_CNT 4
+#define BLOCK_SIZE 512
+#define BUF_SIZE (100 * BLOCK_SIZE)
+
+#endif /* tests/filesys/base/par-read.h */
@@ -0,0 +1,55 @@
+/* Writes a 4 MB file, then reads it back sequentially in 4 kB
+   chunks and checks every byte.  The "Buffer cache" line printed
+   at shutdown gives the number of sectors read ahead and how many
+   of them the reads then found in the cache. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK_SIZE 4096
+#define CHUNK_CNT 1024
+
+static char buf[CHUNK_SIZE];
+static char expected[CHUNK_SIZE];
+
+/* Fills CHUNK with the contents of chunk CHUNK_IDX of the file. */
+static void
+fill_chunk (char *chunk, size_t chunk_idx) 
+{
+  random_init (chunk_idx);
+  random_bytes (chunk, CHUNK_SIZE);
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "seq";
+  size_t i;
+  int fd;
+
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  msg ("writing \"%s\"", file_name);
+  for (i = 0; i < CHUNK_CNT; i++) 
+    {
+      fill_chunk (buf, i);
+      if (write (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("write of chunk %zu in \"%s\" failed", i, file_name);
+    }
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  msg ("reading \"%s\"", file_name);
+  for (i = 0; i < CHUNK_CNT; i++) 
+    {
+      if (read (fd, buf, CHUNK_SIZE) != CHUNK_SIZE)
+        fail ("read of chunk %zu in \"%s\" failed", i, file_name);
+      fill_chunk (expected, i);
+      compare_bytes (buf, expected, CHUNK_SIZE, i * CHUNK_SIZE, file_name);
+    }
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(seq-read) begin
+(seq-read) create "seq"
+(seq-read) open "seq"
+(seq-read) writing "seq"
+(seq-read) close "seq"
+(seq-read) open "seq"
+(seq-read) reading "seq"
+(seq-read) close "seq"
+(seq-read) end
+EOF
+pass;
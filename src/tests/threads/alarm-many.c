@@ -0,0 +1,86 @@
+/* Starts SLEEPER_CNT threads that each sleep ITER_CNT times for
+   a duration of their own, some short and some longer than a
+   full turn of the kernel's timing wheel, and verifies that no
+   thread ever wakes up before it asked to.  With this many
+   sleepers, the timer interrupt must not look at every sleeping
+   thread on every tick.  The test needs more memory than the
+   default, as set in Make.tests. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 2000
+#define ITER_CNT 5
+
+/* Information about an individual sleeper. */
+struct sleeper 
+  {
+    int duration;               /* Number of ticks to sleep. */
+    int early_cnt;              /* Number of times woken too early. */
+  };
+
+static struct semaphore done;
+static thread_func sleeper_thread;
+
+void
+test_alarm_many (void) 
+{
+  struct sleeper *sleepers;
+  int early_cnt;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sleepers = malloc (sizeof *sleepers * SLEEPER_CNT);
+  if (sleepers == NULL)
+    PANIC ("couldn't allocate memory for test");
+  sema_init (&done, 0);
+
+  msg ("starting %d sleepers, %d sleeps each", SLEEPER_CNT, ITER_CNT);
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      struct sleeper *s = &sleepers[i];
+      char name[16];
+
+      s->duration = 1 + i * 7 % 150;
+      s->early_cnt = 0;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper_thread, s) == TID_ERROR)
+        fail ("could not create sleeper %d", i);
+    }
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+
+  early_cnt = 0;
+  for (i = 0; i < SLEEPER_CNT; i++)
+    early_cnt += sleepers[i].early_cnt;
+  if (early_cnt != 0)
+    fail ("sleepers woke up early %d times", early_cnt);
+  msg ("no sleeper woke up early");
+
+  free (sleepers);
+  pass ();
+}
+
+static void
+sleeper_thread (void *s_) 
+{
+  struct sleeper *s = s_;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++) 
+    {
+      int64_t start = timer_ticks ();
+      timer_sleep (s->duration);
+      if (timer_elapsed (start) < s->duration)
+        s->early_cnt++;
+    }
+  sema_up (&done);
+}
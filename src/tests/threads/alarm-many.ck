@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-many) begin
+(alarm-many) starting 2000 sleepers, 5 sleeps each
+(alarm-many) no sleeper woke up early
+(alarm-many) PASS
+(alarm-many) end
+EOF
+pass;
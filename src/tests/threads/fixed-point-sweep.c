@@ -0,0 +1,230 @@
+/* Runs the MLFQS per-second recent_cpu update over THREAD_CNT
+   threads SWEEP_CNT times, once with the inline value-based
+   operations of threads/fixed-point.h and once with out-of-line
+   functions that update a fixed-point number through a pointer,
+   as the kernel's fixed-point library used to.  The two must
+   leave every thread with the same recent_cpu; the ticks each
+   took are printed alongside.
+
+   Since both sweeps use the same formulas, agreeing says nothing
+   about whether the formulas are right, so the operations are
+   first checked against results worked out by hand at the edges
+   of the 17.14 range: negative values, rounding of halves, and
+   values near INT_MAX / FIXED_POINT_ONE. */
+
+#include <debug.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/fixed-point.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 500
+#define SWEEP_CNT 2000
+
+static struct fixed_point recent_cpu[THREAD_CNT];
+static struct fixed_point inline_cpu[THREAD_CNT];
+static int nice[THREAD_CNT];
+
+static void check_boundaries (void);
+static void check (const char *what, int actual, int expected);
+static void reset (void);
+static int64_t sweep_inline (struct fixed_point load_avg);
+static int64_t sweep_out_of_line (struct fixed_point load_avg);
+
+void
+test_fixed_point_sweep (void) 
+{
+  struct fixed_point load_avg = fixed_point_divide_int (
+    fixed_point_create (THREAD_CNT), 3);
+  int64_t inline_ticks, out_of_line_ticks;
+  int i;
+
+  check_boundaries ();
+
+  reset ();
+  inline_ticks = sweep_inline (load_avg);
+  memcpy (inline_cpu, recent_cpu, sizeof recent_cpu);
+  msg ("%d sweeps over %d threads with inline operations "
+       "took %lld ticks", SWEEP_CNT, THREAD_CNT, inline_ticks);
+
+  reset ();
+  out_of_line_ticks = sweep_out_of_line (load_avg);
+  msg ("%d sweeps over %d threads with out-of-line operations "
+       "took %lld ticks", SWEEP_CNT, THREAD_CNT, out_of_line_ticks);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (inline_cpu[i].bits != recent_cpu[i].bits)
+      fail ("thread %d: inline sweeps computed %d, out-of-line sweeps %d",
+            i, inline_cpu[i].bits, recent_cpu[i].bits);
+  pass ();
+}
+
+/* Returns the fixed-point number whose representation is BITS. */
+static struct fixed_point
+from_bits (int bits) 
+{
+  struct fixed_point x = { bits };
+  return x;
+}
+
+/* Checks each operation against exact results.  A fixed-point
+   number with value V has bits V * 16384; the expected bits
+   below are that product for values that are exact in 17.14,
+   and otherwise the product truncated toward zero. */
+static void
+check_boundaries (void) 
+{
+  struct fixed_point half = from_bits (8192);             /* 0.5 */
+
+  /* 131071 is the largest integer that fits, -131072 the
+     smallest. */
+  check ("create (131071)", fixed_point_create (131071).bits, 2147467264);
+  check ("create (-131072)", fixed_point_create (-131072).bits, INT_MIN);
+
+  /* Conversion to int truncates toward zero; rounding takes
+     halves away from zero. */
+  check ("to_int (-2.5)", fixed_point_to_int (from_bits (-40960)), -2);
+  check ("round (2.5)", fixed_point_round (from_bits (40960)), 3);
+  check ("round (-2.5)", fixed_point_round (from_bits (-40960)), -3);
+  check ("round (2.5 - 2**-14)", fixed_point_round (from_bits (40959)), 2);
+  check ("round (-2.5 + 2**-14)",
+         fixed_point_round (from_bits (-40959)), -2);
+  check ("round (max)", fixed_point_round (from_bits (INT_MAX)), 131072);
+  check ("round (min)", fixed_point_round (from_bits (INT_MIN)), -131072);
+
+  /* 1.5 * -2.5 = -3.75 exactly.  max * 0.5 and -2**-14 * 0.5
+     each drop a half of the last bit, toward zero. */
+  check ("1.5 * -2.5",
+         fixed_point_multiply (from_bits (24576), from_bits (-40960)).bits,
+         -61440);
+  check ("max * 0.5", fixed_point_multiply (from_bits (INT_MAX), half).bits,
+         1073741823);
+  check ("-2**-14 * 0.5", fixed_point_multiply (from_bits (-1), half).bits,
+         0);
+  check ("65535 * 2",
+         fixed_point_multiply_int (fixed_point_create (65535), 2).bits,
+         2147450880);
+
+  /* 131071 / 2 = 65535.5, which rounds up.  1 / 3 = 0.33331298...
+     in 17.14, and -1 / 3 its negation.  -7 / 2 = -3.5. */
+  check ("131071 / 2",
+         fixed_point_divide (fixed_point_create (131071),
+                             fixed_point_create (2)).bits, 1073733632);
+  check ("round (131071 / 2)",
+         fixed_point_round (fixed_point_divide (fixed_point_create (131071),
+                                                fixed_point_create (2))),
+         65536);
+  check ("1 / 3", fixed_point_divide (fixed_point_create (1),
+                                      fixed_point_create (3)).bits, 5461);
+  check ("-1 / 3", fixed_point_divide (fixed_point_create (-1),
+                                       fixed_point_create (3)).bits, -5461);
+  check ("-7 / 2",
+         fixed_point_divide_int (fixed_point_create (-7), 2).bits, -57344);
+
+  /* -131072 + 131071 = -1, from the bottom of the range. */
+  check ("-131072 + 131071",
+         fixed_point_add_int (fixed_point_create (-131072), 131071).bits,
+         -16384);
+  check ("max - 131071",
+         fixed_point_subtract (from_bits (INT_MAX),
+                               fixed_point_create (131071)).bits, 16383);
+}
+
+/* Fails unless ACTUAL equals EXPECTED. */
+static void
+check (const char *what, int actual, int expected) 
+{
+  if (actual != expected)
+    fail ("%s: computed %d, expected %d", what, actual, expected);
+}
+
+/* Gives every thread the same recent_cpu and a nice value
+   between -20 and 20. */
+static void
+reset (void) 
+{
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      recent_cpu[i] = fixed_point_create (100);
+      nice[i] = i % 41 - 20;
+    }
+}
+
+static int64_t
+sweep_inline (struct fixed_point load_avg) 
+{
+  int64_t start = timer_ticks ();
+  int sweep, i;
+
+  for (sweep = 0; sweep < SWEEP_CNT; sweep++) 
+    {
+      struct fixed_point twice_load = fixed_point_multiply_int (load_avg, 2);
+      struct fixed_point factor =
+        fixed_point_divide (twice_load, fixed_point_add_int (twice_load, 1));
+
+      for (i = 0; i < THREAD_CNT; i++)
+        recent_cpu[i] = fixed_point_add_int (
+          fixed_point_multiply (recent_cpu[i], factor), nice[i]);
+    }
+  return timer_elapsed (start);
+}
+
+/* Out-of-line, pointer-based versions of the operations. */
+static void NO_INLINE
+copy (struct fixed_point *dst, struct fixed_point *src) 
+{
+  dst->bits = src->bits;
+}
+
+static void NO_INLINE
+add_int (struct fixed_point *x, int n) 
+{
+  x->bits += n * FIXED_POINT_ONE;
+}
+
+static void NO_INLINE
+multiply (struct fixed_point *x, struct fixed_point *y) 
+{
+  x->bits = (int64_t) x->bits * y->bits / FIXED_POINT_ONE;
+}
+
+static void NO_INLINE
+multiply_int (struct fixed_point *x, int n) 
+{
+  x->bits *= n;
+}
+
+static void NO_INLINE
+divide (struct fixed_point *x, struct fixed_point *y) 
+{
+  x->bits = (int64_t) x->bits * FIXED_POINT_ONE / y->bits;
+}
+
+static int64_t
+sweep_out_of_line (struct fixed_point load_avg) 
+{
+  int64_t start = timer_ticks ();
+  int sweep, i;
+
+  for (sweep = 0; sweep < SWEEP_CNT; sweep++) 
+    {
+      struct fixed_point factor, divisor;
+
+      copy (&factor, &load_avg);
+      multiply_int (&factor, 2);
+      copy (&divisor, &factor);
+      add_int (&divisor, 1);
+      divide (&factor, &divisor);
+
+      for (i = 0; i < THREAD_CNT; i++) 
+        {
+          multiply (&recent_cpu[i], &factor);
+          add_int (&recent_cpu[i], nice[i]);
+        }
+    }
+  return timer_elapsed (start);
+}
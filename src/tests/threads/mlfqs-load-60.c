@@ -95,6 +95,11 @@
    After 174 seconds, load average=5.52.
    After 176 seconds, load average=5.33.
    After 178 seconds, load average=5.16.
+
+   mlfqs-load-500 does the same with 500 threads, which makes the
+   per-second scheduler bookkeeping in the timer interrupt handler
+   much more expensive.  Compare the MLFQS statistics printed at
+   shutdown for the two tests.
 */
 
 #include <stdio.h>
@@ -107,20 +112,31 @@
 
 static int64_t start_time;
 
+static void test_mlfqs_load (int thread_cnt);
 static void load_thread (void *aux);
 
-#define THREAD_CNT 60
-
 void
 test_mlfqs_load_60 (void) 
+{
+  test_mlfqs_load (60);
+}
+
+void
+test_mlfqs_load_500 (void) 
+{
+  test_mlfqs_load (500);
+}
+
+static void
+test_mlfqs_load (int thread_cnt) 
 {
   int i;
   
   ASSERT (thread_mlfqs);
 
   start_time = timer_ticks ();
-  msg ("Starting %d niced load threads...", THREAD_CNT);
-  for (i = 0; i < THREAD_CNT; i++) 
+  msg ("Starting %d niced load threads...", thread_cnt);
+  for (i = 0; i < thread_cnt; i++) 
     {
       char name[16];
       snprintf(name, sizeof name, "load %d", i);
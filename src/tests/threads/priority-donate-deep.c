@@ -0,0 +1,109 @@
+/* Builds a chain of DEPTH threads, each holding one lock and
+   waiting for the lock held by the thread before it, with the
+   main thread holding the first lock.  Checks that each new link
+   raises the main thread's priority through the whole chain,
+   that the donation stays in place while the main thread yields
+   YIELD_CNT times, and that releasing the first lock lets the
+   chain unwind and drops the main thread back to its own
+   priority.  The ticks taken by the yields are reported with
+   and without the chain. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define DEPTH 32
+#define YIELD_CNT 10000
+
+static struct lock locks[DEPTH + 1];
+static int chain_exited;
+
+static thread_func chain_thread;
+static int64_t yield_and_check (int expected_priority);
+
+void
+test_priority_donate_deep (void) 
+{
+  int64_t chain_ticks, plain_ticks;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* The donation must make it all the way down the chain. */
+  ASSERT (thread_donation_depth >= DEPTH);
+
+  thread_set_priority (PRI_MIN);
+  for (i = 0; i <= DEPTH; i++)
+    lock_init (&locks[i]);
+  lock_acquire (&locks[0]);
+
+  for (i = 1; i <= DEPTH; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "chain %d", i);
+      if (thread_create (name, PRI_MIN + i, chain_thread, &locks[i])
+          == TID_ERROR)
+        fail ("could not create chain thread %d", i);
+      if (thread_get_priority () != PRI_MIN + i)
+        fail ("after %d chain threads, main has priority %d, "
+              "but should have %d",
+              i, thread_get_priority (), PRI_MIN + i);
+    }
+
+  chain_ticks = yield_and_check (PRI_MIN + DEPTH);
+  msg ("%d yields with a donation through %d locks took %lld ticks",
+       YIELD_CNT, DEPTH, chain_ticks);
+
+  lock_release (&locks[0]);
+  if (chain_exited != DEPTH)
+    fail ("only %d of %d chain threads exited", chain_exited, DEPTH);
+  if (thread_get_priority () != PRI_MIN)
+    fail ("main has priority %d after releasing its lock, "
+          "but should have %d", thread_get_priority (), PRI_MIN);
+
+  plain_ticks = yield_and_check (PRI_MIN);
+  msg ("%d yields with no donation took %lld ticks",
+       YIELD_CNT, plain_ticks);
+
+  thread_set_priority (PRI_DEFAULT);
+  pass ();
+}
+
+/* Yields YIELD_CNT times, checking after each yield that our
+   priority is still EXPECTED_PRIORITY, and returns the number of
+   timer ticks that took. */
+static int64_t
+yield_and_check (int expected_priority) 
+{
+  int64_t start;
+  int i;
+
+  start = timer_ticks ();
+  for (i = 0; i < YIELD_CNT; i++) 
+    {
+      thread_yield ();
+      if (thread_get_priority () != expected_priority)
+        fail ("main has priority %d, but should have %d",
+              thread_get_priority (), expected_priority);
+    }
+  return timer_elapsed (start);
+}
+
+/* Acquires LOCK_, then the lock held by the chain thread created
+   just before this one (or by the main thread), and releases
+   both. */
+static void
+chain_thread (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  lock_acquire (lock - 1);
+  lock_release (lock - 1);
+  lock_release (lock);
+  chain_exited++;
+}
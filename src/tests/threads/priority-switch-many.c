@@ -0,0 +1,119 @@
+/* Fills the run queue with FILLER_CNT threads spread over the
+   priorities between PRI_MIN and PRI_DEFAULT, and checks that
+   thread switches still pick the right thread: a higher-priority
+   partner thread always runs before any filler, and the fillers
+   run in descending order of priority once the main thread
+   lowers its own.  Also reports the ticks taken by SWITCH_CNT semaphore
+   round trips with the partner, with the run queue empty and
+   full, for comparison by hand. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define FILLER_CNT 200
+#define SWITCH_CNT 10000
+
+static struct semaphore ping, pong;
+static bool done;
+static int fillers_exited;
+static int last_priority;
+
+static thread_func partner_thread;
+static thread_func filler_thread;
+static int64_t ping_pong (void);
+
+void
+test_priority_switch_many (void) 
+{
+  int64_t empty_ticks, full_ticks;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  thread_create ("partner", PRI_DEFAULT + 1, partner_thread, NULL);
+
+  empty_ticks = ping_pong ();
+  msg ("%d round trips with no other ready threads took %lld ticks",
+       SWITCH_CNT, empty_ticks);
+
+  for (i = 0; i < FILLER_CNT; i++) 
+    {
+      char name[16];
+      int priority = PRI_MIN + 1 + i % (PRI_DEFAULT - PRI_MIN - 1);
+
+      snprintf (name, sizeof name, "filler %d", i);
+      if (thread_create (name, priority, filler_thread, NULL)
+          == TID_ERROR)
+        fail ("could not create filler thread %d", i);
+    }
+  if (fillers_exited != 0)
+    fail ("a filler thread ran ahead of a higher-priority thread");
+
+  full_ticks = ping_pong ();
+  msg ("%d round trips with %d other ready threads took %lld ticks",
+       SWITCH_CNT, FILLER_CNT, full_ticks);
+
+  /* Stop the partner and let the fillers exit, highest priority
+     first. */
+  done = true;
+  last_priority = PRI_DEFAULT;
+  sema_up (&ping);
+  thread_set_priority (PRI_MIN);
+  if (fillers_exited != FILLER_CNT)
+    fail ("only %d of %d filler threads exited",
+          fillers_exited, FILLER_CNT);
+  thread_set_priority (PRI_DEFAULT);
+
+  pass ();
+}
+
+/* Hands the CPU to the partner thread and back SWITCH_CNT times
+   and returns the number of timer ticks that took. */
+static int64_t
+ping_pong (void) 
+{
+  int64_t start;
+  int i;
+
+  start = timer_ticks ();
+  for (i = 0; i < SWITCH_CNT; i++) 
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  return timer_elapsed (start);
+}
+
+static void
+partner_thread (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      sema_down (&ping);
+      if (done)
+        break;
+      sema_up (&pong);
+    }
+}
+
+static void
+filler_thread (void *aux UNUSED) 
+{
+  int priority = thread_get_priority ();
+
+  if (priority > last_priority)
+    fail ("filler with priority %d ran after one with priority %d",
+          priority, last_priority);
+  last_priority = priority;
+  fillers_exited++;
+}
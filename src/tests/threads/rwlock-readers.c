@@ -0,0 +1,104 @@
+/* Starts THREAD_CNT threads that each hold a reader/writer lock
+   for HOLD_TICKS, first all as readers and then all as writers,
+   and measures how long each group takes.  The readers should
+   hold the lock at the same time, so they should finish in about
+   HOLD_TICKS, whereas the writers have to take turns.
+
+   Then checks that writers are preferred: once a writer waits
+   for a reader to leave, new readers must not get in, and the
+   reader runs with the writer's priority until it leaves. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8
+#define HOLD_TICKS 10
+
+static struct rwlock rwlock;
+static struct semaphore done;
+
+static thread_func reader_thread;
+static thread_func writer_thread;
+static int64_t time_threads (thread_func *);
+
+void
+test_rwlock_readers (void) 
+{
+  int64_t read_ticks, write_ticks;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rwlock);
+  sema_init (&done, 0);
+
+  read_ticks = time_threads (reader_thread);
+  msg ("%d readers holding the lock for %d ticks took %lld ticks",
+       THREAD_CNT, HOLD_TICKS, read_ticks);
+  write_ticks = time_threads (writer_thread);
+  msg ("%d writers holding the lock for %d ticks took %lld ticks",
+       THREAD_CNT, HOLD_TICKS, write_ticks);
+
+  if (read_ticks >= 2 * HOLD_TICKS)
+    fail ("readers did not hold the lock at the same time");
+  if (write_ticks < THREAD_CNT * HOLD_TICKS)
+    fail ("writers held the lock at the same time");
+
+  /* Hold the lock for reading while a higher-priority writer
+     arrives and waits for us to leave. */
+  rwlock_acquire_read (&rwlock);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread, NULL);
+  if (rwlock_try_acquire_read (&rwlock))
+    fail ("a new reader got in while a writer was waiting");
+  if (thread_get_priority () != PRI_DEFAULT + 1)
+    fail ("reader has priority %d while a writer waits, "
+          "but should have %d", thread_get_priority (), PRI_DEFAULT + 1);
+  rwlock_release_read (&rwlock);
+  if (thread_get_priority () != PRI_DEFAULT)
+    fail ("reader has priority %d after leaving, but should have %d",
+          thread_get_priority (), PRI_DEFAULT);
+  sema_down (&done);
+
+  pass ();
+}
+
+/* Runs THREAD_CNT threads of FUNC and returns the number of
+   timer ticks until all of them are done. */
+static int64_t
+time_threads (thread_func *func) 
+{
+  int64_t start = timer_ticks ();
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "thread %d", i);
+      thread_create (name, PRI_DEFAULT, func, NULL);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  return timer_elapsed (start);
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_read (&rwlock);
+  timer_sleep (HOLD_TICKS);
+  rwlock_release_read (&rwlock);
+  sema_up (&done);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  rwlock_acquire_write (&rwlock);
+  timer_sleep (HOLD_TICKS);
+  rwlock_release_write (&rwlock);
+  sema_up (&done);
+}
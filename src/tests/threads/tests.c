@@ -17,6 +17,7 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-many", test_alarm_many},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -29,8 +30,13 @@ static const struct test tests[] =
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-donate-deep", test_priority_donate_deep},
+    {"priority-switch-many", test_priority_switch_many},
+    {"fixed-point-sweep", test_fixed_point_sweep},
+    {"rwlock-readers", test_rwlock_readers},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
+    {"mlfqs-load-500", test_mlfqs_load_500},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
     {"mlfqs-recent-1", test_mlfqs_recent_1},
     {"mlfqs-fair-2", test_mlfqs_fair_2},
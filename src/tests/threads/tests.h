@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_many;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -23,8 +24,13 @@ extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_donate_deep;
+extern test_func test_priority_switch_many;
+extern test_func test_fixed_point_sweep;
+extern test_func test_rwlock_readers;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
+extern test_func test_mlfqs_load_500;
 extern test_func test_mlfqs_load_avg;
 extern test_func test_mlfqs_recent_1;
 extern test_func test_mlfqs_fair_2;
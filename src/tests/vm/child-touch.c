@@ -0,0 +1,37 @@
+/* Child process of page-fault-par.
+   Writes one byte to each page of a 256 kB buffer, then reads
+   the pages back several times in a scattered order, checking
+   the bytes, so that pages evicted in between are faulted in
+   again.  Exits with the child number from the command line. */
+
+#include <stdlib.h>
+#include "tests/lib.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+#define ROUND_CNT 8
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+int
+main (int argc, char *argv[])
+{
+  int id = atoi (argv[argc - 1]);
+  size_t i, round;
+
+  test_name = "child-touch";
+
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE_SIZE] = id + i;
+
+  /* 7 is prime to PAGE_CNT, so each round visits every page. */
+  for (round = 0; round < ROUND_CNT; round++)
+    for (i = 0; i < PAGE_CNT; i++)
+      {
+        size_t page = (i * 7 + round) % PAGE_CNT;
+        if (buf[page * PAGE_SIZE] != (char) (id + page))
+          fail ("page %zu has wrong contents", page);
+      }
+
+  return id;
+}
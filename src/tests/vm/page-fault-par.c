@@ -0,0 +1,23 @@
+/* Runs 16 child-touch processes at once.  Together they touch
+   more pages than fit in memory, so pages are evicted and faulted
+   back in across many address spaces.  The page fault, page-in
+   and eviction statistics printed at shutdown measure the cost
+   of each fault. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 16
+
+void
+test_main (void)
+{
+  pid_t children[CHILD_CNT];
+
+  quiet = true;
+  exec_children ("child-touch", children, CHILD_CNT);
+  wait_children (children, CHILD_CNT);
+  quiet = false;
+  msg ("%d children finished", CHILD_CNT);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-fault-par) begin
+(page-fault-par) 16 children finished
+(page-fault-par) end
+EOF
+pass;
@@ -1,24 +1,104 @@
 #ifndef THREADS_FIXED_POINT_H
 #define THREADS_FIXED_POINT_H
 
+#include <stdint.h>
+
+/* 17.14 fixed-point arithmetic for the MLFQS formulas of
+   Section B.6.  Values are passed and returned by value, and
+   every operation is inline, so that the scheduler's per-tick
+   and per-second updates compile to a few instructions. */
+
+/* Number of fraction bits. */
+#define FIXED_POINT_SHIFT 14
+#define FIXED_POINT_ONE (1 << FIXED_POINT_SHIFT)
+
 struct fixed_point
   {
     int bits;  /* 17.14 fixed-point number representation */
   };
 
-void fixed_point_init (struct fixed_point *fp, int value);
-void fixed_point_copy (struct fixed_point *fp1, struct fixed_point *fp2);
-struct fixed_point fixed_point_create (int value);
-struct fixed_point fixed_point_get_copied (struct fixed_point *fp);
-void fixed_point_add_int (struct fixed_point *fp, int value);
-void fixed_point_substract (struct fixed_point *fp1, struct fixed_point *fp2);
-void fixed_point_multiply (struct fixed_point *fp1, struct fixed_point *fp2);
-void fixed_point_multiply_int (struct fixed_point *fp, int value);
-struct fixed_point fixed_point_get_multiplied_int (struct fixed_point *fp, int value);
-void fixed_point_divide (struct fixed_point *fp1, struct fixed_point *fp2);
-void fixed_point_divide_int (struct fixed_point *fp, int value);
-struct fixed_point fixed_point_get_divided_int (struct fixed_point *fp, int value);
-int fixed_point_to_int (struct fixed_point *fp);
-void fixed_point_print (struct fixed_point *fp);
+/* Returns integer N as a fixed-point number. */
+static inline struct fixed_point
+fixed_point_create (int n)
+{
+  struct fixed_point x = { n * FIXED_POINT_ONE };
+  return x;
+}
+
+/* Returns X truncated toward zero. */
+static inline int
+fixed_point_to_int (struct fixed_point x)
+{
+  return x.bits / FIXED_POINT_ONE;
+}
+
+/* Returns X rounded to the nearest integer, halves away from
+   zero.  Adding the half is done in 64 bits so that it cannot
+   overflow for X near the ends of the range. */
+static inline int
+fixed_point_round (struct fixed_point x)
+{
+  int64_t bits = x.bits;
+
+  return (bits >= 0
+          ? (bits + FIXED_POINT_ONE / 2) / FIXED_POINT_ONE
+          : (bits - FIXED_POINT_ONE / 2) / FIXED_POINT_ONE);
+}
+
+/* Returns X + Y. */
+static inline struct fixed_point
+fixed_point_add (struct fixed_point x, struct fixed_point y)
+{
+  x.bits += y.bits;
+  return x;
+}
+
+/* Returns X + N. */
+static inline struct fixed_point
+fixed_point_add_int (struct fixed_point x, int n)
+{
+  x.bits += n * FIXED_POINT_ONE;
+  return x;
+}
+
+/* Returns X - Y. */
+static inline struct fixed_point
+fixed_point_subtract (struct fixed_point x, struct fixed_point y)
+{
+  x.bits -= y.bits;
+  return x;
+}
+
+/* Returns X * Y. */
+static inline struct fixed_point
+fixed_point_multiply (struct fixed_point x, struct fixed_point y)
+{
+  x.bits = (int64_t) x.bits * y.bits / FIXED_POINT_ONE;
+  return x;
+}
+
+/* Returns X * N. */
+static inline struct fixed_point
+fixed_point_multiply_int (struct fixed_point x, int n)
+{
+  x.bits *= n;
+  return x;
+}
+
+/* Returns X / Y. */
+static inline struct fixed_point
+fixed_point_divide (struct fixed_point x, struct fixed_point y)
+{
+  x.bits = (int64_t) x.bits * FIXED_POINT_ONE / y.bits;
+  return x;
+}
+
+/* Returns X / N. */
+static inline struct fixed_point
+fixed_point_divide_int (struct fixed_point x, int n)
+{
+  x.bits /= n;
+  return x;
+}
 
 #endif /* threads/fixed-point.h */
@@ -21,6 +21,7 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/sched-trace.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -32,14 +33,14 @@
 #include "tests/threads/tests.h"
 #endif
 #ifdef VM
-#include "vm/mmap_table.h"
-#include "vm/suppl_page_table.h"
+#include "vm/frame_table.h"
 #include "vm/swap_table.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
 #include "filesys/filesys.h"
+#include "filesys/fs-cache.h"
 #include "filesys/fsutil.h"
 #endif
 
@@ -137,8 +138,7 @@ main (void)
 #endif
 
 #ifdef VM
-  mmap_table_init ();
-  suppl_page_table_init ();
+  frame_table_init ();
   swap_table_init ();
 #endif
 
@@ -262,6 +262,28 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-cache-policy"))
+        {
+          if (value != NULL && !strcmp (value, "fifo"))
+            fs_cache_set_policy (FS_CACHE_FIFO);
+          else if (value != NULL && !strcmp (value, "clock"))
+            fs_cache_set_policy (FS_CACHE_CLOCK);
+          else
+            PANIC ("unknown buffer cache policy `%s'", value);
+        }
+      else if (!strcmp (name, "-fs-cache"))
+        fs_cache_set_size (atoi (value));
+      else if (!strcmp (name, "-io-sched"))
+        {
+          if (value != NULL && !strcmp (value, "fifo"))
+            block_set_scheduler (BLOCK_SCHED_FIFO);
+          else if (value != NULL && !strcmp (value, "clook"))
+            block_set_scheduler (BLOCK_SCHED_CLOOK);
+          else if (value != NULL && !strcmp (value, "deadline"))
+            block_set_scheduler (BLOCK_SCHED_DEADLINE);
+          else
+            PANIC ("unknown I/O scheduler `%s'", value);
+        }
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -271,6 +293,10 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-donate-depth"))
+        thread_donation_depth = atoi (value);
+      else if (!strcmp (name, "-sched-trace"))
+        sched_trace_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -388,12 +414,17 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -cache-policy=POL  Use POL (fifo or clock) for the buffer cache.\n"
+          "  -fs-cache=COUNT    Cache up to COUNT sectors (default 64).\n"
+          "  -io-sched=SCHED    Use SCHED (fifo, clook or deadline) for disks.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -donate-depth=N    Donate priority through at most N locks (default 8).\n"
+          "  -sched-trace       Trace scheduling, print histograms at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -155,6 +155,32 @@ palloc_get_available_capcity (enum palloc_flags flags)
   return bitmap_count (pool->used_map, 0, bitmap_size (pool->used_map), false);
 }
 
+/* Returns the number of pages in the user pool. */
+size_t
+palloc_user_page_cnt (void)
+{
+  return bitmap_size (user_pool.used_map);
+}
+
+/* Returns the index of PAGE, which must be in the user pool,
+   among the pages of the user pool. */
+size_t
+palloc_user_page_index (const void *page)
+{
+  ASSERT (page_from_pool (&user_pool, (void *) page));
+
+  return pg_no (page) - pg_no (user_pool.base);
+}
+
+/* Returns the user pool page with index IDX. */
+void *
+palloc_user_page (size_t idx)
+{
+  ASSERT (idx < palloc_user_page_cnt ());
+
+  return user_pool.base + idx * PGSIZE;
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
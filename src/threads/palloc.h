@@ -17,5 +17,8 @@ void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
 size_t palloc_get_available_capcity (enum palloc_flags);
+size_t palloc_user_page_cnt (void);
+size_t palloc_user_page_index (const void *);
+void *palloc_user_page (size_t idx);
 
 #endif /* threads/palloc.h */
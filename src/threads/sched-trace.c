@@ -0,0 +1,214 @@
+#include "threads/sched-trace.h"
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "devices/timer.h"
+
+/* Scheduler tracing.
+
+   Events go into a ring buffer of TRACE_SIZE entries, which
+   keeps the most recent ones.  Recording an event only stores
+   into the next slot with interrupts off, so it takes no lock
+   and can be done from schedule() and from interrupt handlers.
+   Times are measured in microseconds with timer_usecs(), since
+   most run queue waits and lock holds are much shorter than a
+   timer tick.
+
+   Besides the events, two histograms are kept for each thread:
+   how long it waits in the run queue before it is scheduled, and
+   how long it holds locks.  They are kept here rather than in
+   struct thread so that they outlive the thread.
+   sched_trace_print_stats() prints them, with the last few
+   events, at shutdown. */
+
+#define TRACE_SIZE 1024         /* Events kept, a power of 2. */
+#define TRACE_DUMP_CNT 16       /* Events printed at shutdown. */
+#define HIST_BUCKETS 16         /* Histogram buckets. */
+#define HIST_THREAD_CNT 64      /* Threads with histograms of their own. */
+
+bool sched_trace_enabled;
+
+/* A recorded event. */
+struct trace_entry
+  {
+    int64_t time;               /* Microseconds since boot. */
+    enum sched_trace_type type; /* Kind of event. */
+    tid_t tid;                  /* Thread the event is about. */
+    int arg;                    /* Depends on TYPE. */
+  };
+
+static struct trace_entry ring[TRACE_SIZE];
+static unsigned long long event_cnt;    /* # of events recorded. */
+
+/* Histograms of one thread.  Bucket 0 counts 0 us, bucket B > 0
+   counts 2**(B-1) through 2**B - 1 us, and the last bucket
+   counts everything longer. */
+struct thread_hist
+  {
+    tid_t tid;                  /* Thread, or 0 if the slot is unused. */
+    char name[16];              /* Its name. */
+    long long ready[HIST_BUCKETS];      /* Run queue latency. */
+    long long hold[HIST_BUCKETS];       /* Lock hold time. */
+  };
+
+/* Threads are numbered from 1 in order of creation, so the
+   first HIST_THREAD_CNT - 1 get the slot of their tid, and all
+   later ones share slot 0. */
+static struct thread_hist hists[HIST_THREAD_CNT];
+
+static const char *type_names[] =
+  {"switch to", "wakeup", "block", "donate to", "contend"};
+
+static struct thread_hist *get_hist (struct thread *);
+static void hist_add (long long hist[], int64_t usecs);
+static void hist_print (const char *title, long long hist[]);
+
+/* Records an event of the given TYPE about thread TID. */
+void
+sched_trace (enum sched_trace_type type, tid_t tid, int arg)
+{
+  enum intr_level old_level;
+  struct trace_entry *e;
+
+  if (!sched_trace_enabled)
+    return;
+
+  old_level = intr_disable ();
+  e = &ring[event_cnt++ % TRACE_SIZE];
+  e->time = timer_usecs ();
+  e->type = type;
+  e->tid = tid;
+  e->arg = arg;
+  intr_set_level (old_level);
+}
+
+/* Records that thread T waited USECS in the run queue. */
+void
+sched_trace_ready_latency (struct thread *t, int64_t usecs)
+{
+  enum intr_level old_level;
+
+  if (!sched_trace_enabled)
+    return;
+
+  old_level = intr_disable ();
+  hist_add (get_hist (t)->ready, usecs);
+  intr_set_level (old_level);
+}
+
+/* Records that thread T held a lock for USECS. */
+void
+sched_trace_lock_hold (struct thread *t, int64_t usecs)
+{
+  enum intr_level old_level;
+
+  if (!sched_trace_enabled)
+    return;
+
+  old_level = intr_disable ();
+  hist_add (get_hist (t)->hold, usecs);
+  intr_set_level (old_level);
+}
+
+/* Prints the histograms and the most recent events. */
+void
+sched_trace_print_stats (void)
+{
+  unsigned long long i, first;
+  int slot;
+
+  if (!sched_trace_enabled)
+    return;
+
+  printf ("Scheduler trace: %llu events, %llu dropped\n", event_cnt,
+          event_cnt > TRACE_SIZE ? event_cnt - TRACE_SIZE : 0);
+  for (slot = 1; slot <= HIST_THREAD_CNT; slot++)
+    {
+      struct thread_hist *h = &hists[slot % HIST_THREAD_CNT];
+      if (h->tid == 0)
+        continue;
+      if (h->tid == TID_ERROR)
+        printf ("Threads %d and later:\n", HIST_THREAD_CNT);
+      else
+        printf ("Thread %d (%s):\n", h->tid, h->name);
+      hist_print ("  Run queue latency", h->ready);
+      hist_print ("  Lock hold time", h->hold);
+    }
+
+  first = event_cnt > TRACE_DUMP_CNT ? event_cnt - TRACE_DUMP_CNT : 0;
+  for (i = first; i < event_cnt; i++)
+    {
+      struct trace_entry *e = &ring[i % TRACE_SIZE];
+      printf ("  %10lld us: %s %d", e->time, type_names[e->type], e->tid);
+      if (e->type == SCHED_TRACE_SWITCH)
+        printf (" from %d", e->arg);
+      else if (e->type == SCHED_TRACE_WAKEUP
+               || e->type == SCHED_TRACE_DONATE)
+        printf (" at priority %d", e->arg);
+      else if (e->type == SCHED_TRACE_CONTEND)
+        printf (" on lock held by %d", e->arg);
+      printf ("\n");
+    }
+}
+
+/* Returns the histograms of thread T, claiming a slot for them
+   the first time.  Interrupts must be off. */
+static struct thread_hist *
+get_hist (struct thread *t)
+{
+  struct thread_hist *h;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->tid > 0 && t->tid < HIST_THREAD_CNT)
+    {
+      h = &hists[t->tid];
+      if (h->tid == 0)
+        {
+          h->tid = t->tid;
+          strlcpy (h->name, t->name, sizeof h->name);
+        }
+    }
+  else
+    {
+      h = &hists[0];
+      h->tid = TID_ERROR;
+    }
+  return h;
+}
+
+/* Counts USECS in histogram HIST. */
+static void
+hist_add (long long hist[], int64_t usecs)
+{
+  int bucket = 0;
+
+  while (usecs > 0 && bucket < HIST_BUCKETS - 1)
+    {
+      usecs >>= 1;
+      bucket++;
+    }
+  hist[bucket]++;
+}
+
+/* Prints histogram HIST, skipping empty buckets. */
+static void
+hist_print (const char *title, long long hist[])
+{
+  int b;
+
+  printf ("%s (us):", title);
+  for (b = 0; b < HIST_BUCKETS; b++)
+    if (hist[b] != 0)
+      {
+        if (b == 0)
+          printf (" 0: %lld", hist[b]);
+        else if (b == HIST_BUCKETS - 1)
+          printf (" %d+: %lld", 1 << (b - 1), hist[b]);
+        else if (b == 1)
+          printf (" 1: %lld", hist[b]);
+        else
+          printf (" %d-%d: %lld", 1 << (b - 1), (1 << b) - 1, hist[b]);
+      }
+  printf ("\n");
+}
@@ -0,0 +1,27 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+/* Kinds of scheduler events. */
+enum sched_trace_type
+  {
+    SCHED_TRACE_SWITCH,         /* Switched to TID from thread ARG. */
+    SCHED_TRACE_WAKEUP,         /* TID unblocked, at priority ARG. */
+    SCHED_TRACE_BLOCK,          /* TID blocked. */
+    SCHED_TRACE_DONATE,         /* TID received priority ARG. */
+    SCHED_TRACE_CONTEND         /* TID waits for lock held by ARG. */
+  };
+
+/* If false (default), record nothing.
+   Controlled by kernel command-line option "-sched-trace". */
+extern bool sched_trace_enabled;
+
+void sched_trace (enum sched_trace_type, tid_t tid, int arg);
+void sched_trace_ready_latency (struct thread *, int64_t usecs);
+void sched_trace_lock_hold (struct thread *, int64_t usecs);
+void sched_trace_print_stats (void);
+
+#endif /* threads/sched-trace.h */
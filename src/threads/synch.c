@@ -29,9 +29,13 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
+#include "threads/sched-trace.h"
 #include "threads/thread.h"
 
+static void sema_add_waiter (struct semaphore *, struct thread *);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -40,7 +44,10 @@
      decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-     thread, if any). */
+     thread, if any).
+
+   Waiters are kept in order of priority, highest first, so that
+   sema_up() wakes the highest-priority one without a scan. */
 void
 sema_init (struct semaphore *sema, unsigned value) 
 {
@@ -66,12 +73,15 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  while (sema->value == 0) 
+  if (sema->value > 0)
+    sema->value--;
+  else
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      /* sema_up() hands its increment straight to the thread it
+         wakes, so there is nothing to decrement once we wake. */
+      sema_add_waiter (sema, thread_current ());
       thread_block ();
     }
-  sema->value--;
   intr_set_level (old_level);
 }
 
@@ -102,27 +112,53 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up all threads waiting for SEMA.
+   and wakes up the highest-priority thread waiting for SEMA, if
+   any.  The increment is handed directly to that thread, which
+   then cannot lose it to another thread calling sema_down()
+   before it runs.  If it has a higher priority than the running
+   thread, it runs right away.
 
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) 
 {
   enum intr_level old_level;
+  bool preempt = false;
 
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  while (!list_empty (&sema->waiters))
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
-  sema->value++;
+  if (!list_empty (&sema->waiters))
+    {
+      struct thread *t = list_entry (list_pop_front (&sema->waiters),
+                                     struct thread, elem);
+      t->waiting_sema = NULL;
+      thread_unblock (t);
+      preempt = get_thread_priority (t) > thread_get_priority ();
+    }
+  else
+    sema->value++;
   intr_set_level (old_level);
 
-  if (intr_context ())
-    intr_yield_on_return ();
-  else
-    thread_try_yield ();
+  if (preempt)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_try_yield ();
+    }
+}
+
+/* Adds thread T, which is about to block, to SEMA's waiters in
+   order of priority.  Interrupts must be off. */
+static void
+sema_add_waiter (struct semaphore *sema, struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->waiting_sema = sema;
+  list_insert_ordered (&sema->waiters, &t->elem,
+                       thread_priority_greater, NULL);
 }
 
 static void sema_test_helper (void *sema_);
@@ -186,6 +222,27 @@ lock_init (struct lock *lock)
   sema_init (&lock->semaphore, 1);
 }
 
+/* Makes the running thread the holder of LOCK, which it just
+   acquired, and takes over the donations of any threads still
+   waiting for LOCK.  Interrupts must be off. */
+static void
+take_lock (struct lock *lock)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->holder = cur;
+  list_push_back (&cur->acquired_lock_list, &lock->elem);
+  if (sched_trace_enabled)
+    lock->acquired_at = timer_usecs ();
+
+  /* The first waiter has the highest priority. */
+  if (!list_empty (&lock->semaphore.waiters))
+    thread_donate_priority (list_entry (list_front (&lock->semaphore.waiters),
+                                        struct thread, elem));
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -197,13 +254,33 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
-  list_push_back (&thread_current ()->acquired_lock_list, &lock->elem);
+  /* Same as sema_down(), except that while we wait we donate our
+     priority to the holder and down its chain of waited-for
+     locks.  The holder may be null if the lock has just been
+     handed to a thread that has not run yet; that thread takes
+     over our donation when it does. */
+  old_level = intr_disable ();
+  if (lock->semaphore.value > 0)
+    lock->semaphore.value--;
+  else
+    {
+      sema_add_waiter (&lock->semaphore, cur);
+      cur->waiting_lock = lock;
+      if (lock->holder != NULL)
+        sched_trace (SCHED_TRACE_CONTEND, cur->tid, lock->holder->tid);
+      thread_donate_priority (cur);
+      thread_block ();
+      cur->waiting_lock = NULL;
+    }
+  take_lock (lock);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -215,17 +292,17 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    {
-      lock->holder = thread_current ();
-      list_push_back (&thread_current ()->acquired_lock_list, &lock->elem);
-    }
+    take_lock (lock);
+  intr_set_level (old_level);
   return success;
 }
 
@@ -237,11 +314,21 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* Stop receiving the donations of LOCK's waiters. */
+  old_level = intr_disable ();
+  if (sched_trace_enabled)
+    sched_trace_lock_hold (thread_current (),
+                           timer_usecs () - lock->acquired_at);
   lock->holder = NULL;
-  list_remove(&lock->elem);
+  list_remove (&lock->elem);
+  thread_refresh_priority (thread_current ());
+  intr_set_level (old_level);
+
   sema_up (&lock->semaphore);
 }
 
@@ -261,8 +348,405 @@ struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static list_less_func semaphore_elem_less;
+
+/* List of all mutexes, for mutex_print_stats(). */
+static struct list all_mutexes = LIST_INITIALIZER (all_mutexes);
+
+/* Atomically stores NEW into *P and returns the old value. */
+static inline int
+atomic_xchg (volatile int *p, int new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Atomically stores NEW into *P if *P equals OLD, and returns
+   the value *P had. */
+static inline int
+atomic_cmpxchg (volatile int *p, int old, int new)
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Initializes mutex M, named NAME.  A mutex is a lock meant for
+   critical sections that last only a few instructions, like
+   allocating a tid or a page.  Acquiring and releasing a free
+   mutex takes a single atomic instruction each, without
+   disabling interrupts or touching a waiter list.  A thread that
+   finds the mutex held blocks as it would for a lock, but does
+   not donate its priority, so a mutex must never be held across
+   anything that sleeps.
+
+   M is listed in the statistics printed at shutdown, so it must
+   stay in place for as long as the kernel runs. */
+void
+mutex_init (struct mutex *m, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (m != NULL);
+  ASSERT (name != NULL);
+
+  m->state = 0;
+  m->holder = NULL;
+  list_init (&m->waiters);
+  m->name = name;
+  m->acquire_cnt = m->contend_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_mutexes, &m->elem);
+  intr_set_level (old_level);
+}
+
+/* Acquires M, sleeping until it becomes available if
+   necessary.  M must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+mutex_acquire (struct mutex *m)
+{
+  enum intr_level old_level;
+
+  ASSERT (m != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!mutex_held_by_current_thread (m));
+
+  if (atomic_cmpxchg (&m->state, 0, 1) != 0)
+    {
+      /* Contended.  Mark the mutex as having waiters, so that
+         mutex_release() wakes us, and sleep until we find it
+         free. */
+      old_level = intr_disable ();
+      m->contend_cnt++;
+      while (atomic_xchg (&m->state, 2) != 0)
+        {
+          list_insert_ordered (&m->waiters, &thread_current ()->elem,
+                               thread_priority_greater, NULL);
+          thread_block ();
+        }
+      intr_set_level (old_level);
+    }
+  m->holder = thread_current ();
+  m->acquire_cnt++;
+}
+
+/* Tries to acquire M and returns true if successful or false
+   on failure.  M must not already be held by the current
+   thread.
+
+   This function will not sleep, so it may be called within an
+   interrupt handler. */
+bool
+mutex_try_acquire (struct mutex *m)
+{
+  ASSERT (m != NULL);
+  ASSERT (!mutex_held_by_current_thread (m));
+
+  if (atomic_cmpxchg (&m->state, 0, 1) != 0)
+    return false;
+  m->holder = thread_current ();
+  m->acquire_cnt++;
+  return true;
+}
+
+/* Tries to acquire M for up to TICKS timer ticks and returns
+   true if successful or false if M was still held when the time
+   ran out.  Waits among M's waiters as mutex_acquire() does, but
+   with a timer deadline that takes the thread off the waiter
+   list if it is still there.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool
+mutex_acquire_timeout (struct mutex *m, int64_t ticks)
+{
+  int64_t deadline = timer_ticks () + ticks;
+  enum intr_level old_level;
+  bool success = true;
+
+  ASSERT (m != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!mutex_held_by_current_thread (m));
+
+  if (atomic_cmpxchg (&m->state, 0, 1) != 0)
+    {
+      old_level = intr_disable ();
+      m->contend_cnt++;
+      while (atomic_xchg (&m->state, 2) != 0)
+        {
+          list_insert_ordered (&m->waiters, &thread_current ()->elem,
+                               thread_priority_greater, NULL);
+          if (!thread_block_until (deadline))
+            {
+              /* The mutex stays marked as having waiters, which
+                 costs at most one needless check of the list. */
+              success = false;
+              break;
+            }
+        }
+      intr_set_level (old_level);
+      if (!success)
+        return false;
+    }
+  m->holder = thread_current ();
+  m->acquire_cnt++;
+  return true;
+}
+
+/* Releases M, which must be owned by the current thread, and
+   wakes the highest-priority waiter, if any. */
+void
+mutex_release (struct mutex *m)
+{
+  enum intr_level old_level;
+  bool preempt = false;
+
+  ASSERT (m != NULL);
+  ASSERT (mutex_held_by_current_thread (m));
+
+  m->holder = NULL;
+  if (atomic_xchg (&m->state, 0) == 2)
+    {
+      old_level = intr_disable ();
+      if (!list_empty (&m->waiters))
+        {
+          struct thread *t = list_entry (list_pop_front (&m->waiters),
+                                         struct thread, elem);
+          thread_unblock (t);
+          preempt = get_thread_priority (t) > thread_get_priority ();
+        }
+      intr_set_level (old_level);
+      if (preempt)
+        thread_try_yield ();
+    }
+}
+
+/* Returns true if the current thread holds M, false
+   otherwise.  (Note that testing whether some other thread holds
+   a mutex would be racy.) */
+bool
+mutex_held_by_current_thread (const struct mutex *m)
+{
+  ASSERT (m != NULL);
+
+  return m->holder == thread_current ();
+}
+
+/* Prints how often each mutex was acquired and how often that
+   meant waiting for another thread. */
+void
+mutex_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_mutexes); e != list_end (&all_mutexes);
+       e = list_next (e))
+    {
+      struct mutex *m = list_entry (e, struct mutex, elem);
+      printf ("Mutex %s: %llu acquires, %llu contended\n",
+              m->name, m->acquire_cnt, m->contend_cnt);
+    }
+}
+
+/* Initializes RW as a reader/writer lock.  Any number of
+   threads may hold RW for reading at once, or one thread for
+   writing.
+
+   Writers are preferred: as soon as a writer arrives, new
+   readers wait until it is done, so readers cannot starve it.
+   This comes from the write lock inside RW, which a writer holds
+   from when it arrives to when it is done, and which a reader
+   holds only long enough to count itself in.  A reader or writer
+   waiting for the write lock therefore donates its priority to
+   the writer, as for any lock.  A writer waiting for readers to
+   leave donates its priority to each of them, so RW keeps a list
+   of its readers.  A thread may hold at most
+   THREAD_READ_HOLD_CNT reader/writer locks for reading at once. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->write_lock);
+  list_init (&rw->readers);
+  rw->writer_waiting = false;
+  sema_init (&rw->drained, 0);
+}
+
+/* Adds the running thread to RW's readers.  Interrupts must be
+   off. */
+static void
+add_reader (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < THREAD_READ_HOLD_CNT; i++)
+    if (cur->read_holds[i].rwlock == NULL)
+      {
+        cur->read_holds[i].rwlock = rw;
+        list_push_back (&rw->readers, &cur->read_holds[i].elem);
+        return;
+      }
+  PANIC ("%s holds too many reader/writer locks for reading", cur->name);
+}
+
+/* Removes the running thread from RW's readers.  Interrupts must
+   be off. */
+static void
+remove_reader (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < THREAD_READ_HOLD_CNT; i++)
+    if (cur->read_holds[i].rwlock == rw)
+      {
+        cur->read_holds[i].rwlock = NULL;
+        list_remove (&cur->read_holds[i].elem);
+        return;
+      }
+  NOT_REACHED ();
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it or
+   waits for it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->write_lock);
+  old_level = intr_disable ();
+  add_reader (rw);
+  intr_set_level (old_level);
+  lock_release (&rw->write_lock);
+}
+
+/* Tries to acquire RW for reading and returns true if
+   successful or false if a writer holds it or waits for it. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->write_lock))
+    return false;
+  old_level = intr_disable ();
+  add_reader (rw);
+  intr_set_level (old_level);
+  lock_release (&rw->write_lock);
+  return true;
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool last;
+
+  ASSERT (rw != NULL);
+
+  /* Stop receiving the donation of a waiting writer, then let it
+     in if we were the last reader. */
+  old_level = intr_disable ();
+  remove_reader (rw);
+  last = list_empty (&rw->readers) && rw->writer_waiting;
+  if (last)
+    rw->writer_waiting = false;
+  thread_refresh_priority (thread_current ());
+  if (last)
+    sema_up (&rw->drained);
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->write_lock);
+  old_level = intr_disable ();
+  if (!list_empty (&rw->readers))
+    {
+      /* No reader can get in now, so wait once for the readers
+         still inside to leave, donating to them meanwhile. */
+      struct thread *cur = thread_current ();
+
+      rw->writer_waiting = true;
+      cur->waiting_rwlock = rw;
+      thread_donate_priority (cur);
+      sema_down (&rw->drained);
+      cur->waiting_rwlock = NULL;
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing and returns true if
+   successful or false if another thread holds it. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  if (!lock_try_acquire (&rw->write_lock))
+    return false;
+  if (!list_empty (&rw->readers))
+    {
+      lock_release (&rw->write_lock);
+      return false;
+    }
+  return true;
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rwlock_held_for_write (rw));
+
+  lock_release (&rw->write_lock);
+}
+
+/* Returns true if the current thread holds RW for writing,
+   false otherwise. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return lock_held_by_current_thread (&rw->write_lock);
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -271,7 +755,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  sema_init (&cond->semaphore, 0);
+  list_init (&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -302,8 +786,15 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
   
+  /* Each waiter has its own semaphore, queued while LOCK is still
+     held, so a signal sent after LOCK is released but before this
+     thread blocks is kept in the semaphore rather than lost. */
+  struct semaphore_elem waiter;
+  sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
+  list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
-  sema_down (&cond->semaphore);
+  sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
@@ -322,7 +813,16 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  sema_up (&cond->semaphore);
+  /* Wake the highest-priority waiter, the earliest among equals.
+     Priorities may have changed since the waiters queued, so the
+     list is searched rather than kept sorted. */
+  if (!list_empty (&cond->waiters)) 
+    {
+      struct list_elem *e = list_max (&cond->waiters,
+                                      semaphore_elem_less, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -337,6 +837,20 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->semaphore.waiters))
+  while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Returns true if the thread waiting on semaphore_elem A_ has a
+   lower priority than the one waiting on B_. */
+static bool
+semaphore_elem_less (const struct list_elem *a_,
+                     const struct list_elem *b_, void *aux UNUSED)
+{
+  const struct semaphore_elem *a
+    = list_entry (a_, struct semaphore_elem, elem);
+  const struct semaphore_elem *b
+    = list_entry (b_, struct semaphore_elem, elem);
+
+  return get_thread_priority (a->thread) < get_thread_priority (b->thread);
+}
@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -22,6 +23,7 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    int64_t acquired_at;        /* When acquired, in us, if tracing. */
 
     /* List element for struct thread. struct thread holds list of acquired locks as acquired_lock_list. */
     struct list_elem elem;
@@ -33,10 +35,49 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Mutex: a lock for short critical sections.  Cheaper than
+   struct lock when uncontended, but does no priority donation. */
+struct mutex
+  {
+    volatile int state;         /* 0=free, 1=held, 2=held with waiters. */
+    struct thread *holder;      /* Thread holding mutex (for debugging). */
+    struct list waiters;        /* Waiting threads, by priority. */
+    const char *name;           /* Name, for statistics. */
+    unsigned long long acquire_cnt;     /* # of acquisitions. */
+    unsigned long long contend_cnt;     /* # that had to wait. */
+    struct list_elem elem;      /* Element in list of all mutexes. */
+  };
+
+void mutex_init (struct mutex *, const char *name);
+void mutex_acquire (struct mutex *);
+bool mutex_try_acquire (struct mutex *);
+bool mutex_acquire_timeout (struct mutex *, int64_t ticks);
+void mutex_release (struct mutex *);
+bool mutex_held_by_current_thread (const struct mutex *);
+void mutex_print_stats (void);
+
+/* Reader/writer lock. */
+struct rwlock
+  {
+    struct lock write_lock;     /* Held by a writer, briefly by readers. */
+    struct list readers;        /* struct read_holds of the readers. */
+    bool writer_waiting;        /* Writer waiting for readers to leave? */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
 /* Condition variable. */
 struct condition 
   {
-    struct semaphore semaphore;
+    struct list waiters;        /* List of waiting semaphore_elems. */
   };
 
 void cond_init (struct condition *);
@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <procstat.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -10,6 +11,7 @@
 #include "threads/intr-stubs.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/sched-trace.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -17,8 +19,8 @@
 #include "userprog/process.h"
 #endif
 #ifdef VM
-#include "vm/frame_table.h"
 #include "vm/mmap_table.h"
+#include "vm/suppl_page_table.h"
 #endif
 
 /* Random value for struct thread's `magic' member.
@@ -26,9 +28,24 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, in one queue per
+   priority.  Bit P of ready_bitmap is set whenever
+   ready_queues[P] is nonempty, so that the highest-priority
+   ready thread is found with a bit scan instead of a walk over
+   every ready thread. */
+#define READY_BITMAP_WORDS ((PRI_MAX + 32) / 32)
+static struct list ready_queues[PRI_MAX + 1];
+static uint32_t ready_bitmap[READY_BITMAP_WORDS];
+static size_t ready_cnt;        /* Number of threads in ready_queues. */
+
+/* Sleeping threads, hashed by wake-up tick into a timing wheel
+   of SLEEP_WHEEL_SIZE slots, each sorted by sleep_until.  On
+   each tick thread_tick() only looks at the slot for that tick
+   and stops at the first thread there that is not due yet, so
+   its cost does not grow with the number of threads. */
+#define SLEEP_WHEEL_SIZE 64
+static struct list sleep_wheel[SLEEP_WHEEL_SIZE];
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -40,8 +57,8 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* Mutex used by allocate_tid(). */
+static struct mutex tid_lock;
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -65,8 +82,26 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Most locks a priority donation is passed through.
+   Controlled by kernel command-line option "-donate-depth". */
+int thread_donation_depth = 8;
+
 static struct fixed_point load_avg;
 
+/* The MLFQS decays recent_cpu once per second, but only for the
+   running and ready threads, whose recent_cpu matters right now.
+   A blocked thread misses those updates and catches up with the
+   factors recorded here when it is unblocked.  Every
+   DECAY_HISTORY seconds all threads are brought up to date, so
+   no thread ever needs a factor that has been overwritten. */
+#define DECAY_HISTORY 64
+static struct fixed_point decay_factors[DECAY_HISTORY];
+static int decay_seconds;       /* # of per-second updates so far. */
+
+/* MLFQS statistics. */
+static long long mlfqs_sweeps;  /* # of per-second updates. */
+static long long mlfqs_decays;  /* # of recent_cpu values decayed. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -78,9 +113,18 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
-static int get_thread_priority (struct thread *t);
+static void ready_queue_push (struct thread *, int priority);
+static void ready_queue_remove (struct thread *);
+static int ready_queue_max_priority (void);
+static list_less_func sleep_less;
 static int get_thread_priority_default (struct thread *t);
 static int get_thread_priority_mlfqs (struct thread *t);
+static void donate_from (struct thread *donor, int depth);
+static bool donate_to (struct thread *, int priority);
+static void mlfqs_tick (struct thread *cur);
+static void mlfqs_catch_up (struct thread *t);
+static void mlfqs_update_priority (struct thread *t);
+static int mlfqs_compute_priority (struct thread *t);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -98,10 +142,15 @@ static int get_thread_priority_mlfqs (struct thread *t);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  mutex_init (&tid_lock, "tid");
+  for (i = 0; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
+  for (i = 0; i < SLEEP_WHEEL_SIZE; i++)
+    list_init (&sleep_wheel[i]);
   list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
@@ -112,7 +161,7 @@ thread_init (void)
   /* TID_ERROR indicates initial_thread has no parent. */
   initial_thread->parent_tid = TID_ERROR;
 
-  fixed_point_init(&load_avg, 0);
+  load_avg = fixed_point_create (0);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -139,7 +188,7 @@ thread_tick (void)
 {
   struct thread *cur = thread_current ();
   int64_t ticks = timer_ticks ();
-  struct list_elem *e;
+  struct list *sleepers = &sleep_wheel[ticks % SLEEP_WHEEL_SIZE];
   struct thread *t;
   bool unblocked_sleeping_thread = false;
 
@@ -148,59 +197,41 @@ thread_tick (void)
     idle_ticks++;
 #ifdef USERPROG
   else if (cur->pagedir != NULL)
-    user_ticks++;
+    {
+      user_ticks++;
+      cur->user_ticks++;
+    }
 #endif
   else
-    kernel_ticks++;
+    {
+      kernel_ticks++;
+      cur->kernel_ticks++;
+    }
 
   /* Awake sleeping threads. */
-  for (e = list_begin (&all_list); e != list_end (&all_list);
-        e = list_next (e))
+  while (!list_empty (sleepers))
     {
-      t = list_entry (e, struct thread, allelem);
-      if (ticks >= t->sleep_until)
+      t = list_entry (list_front (sleepers), struct thread, sleep_elem);
+      if (ticks < t->sleep_until)
+        break;
+      list_pop_front (sleepers);
+      t->sleep_until = INT64_MAX;
+
+      /* A thread in thread_block_until() may have been woken
+         already and not yet run to take itself off the wheel. */
+      if (t->status != THREAD_BLOCKED)
+        continue;
+      if (t->timed_wait)
         {
-          t->sleep_until = INT64_MAX;
-          thread_unblock (t);
-          unblocked_sleeping_thread = true;
+          list_remove (&t->elem);
+          t->timed_out = true;
         }
+      thread_unblock (t);
+      unblocked_sleeping_thread = true;
     }
 
-  /* On each timer tick, the running thread's recent_cpu is incremented by 1. */
-  fixed_point_add_int (&cur->recent_cpu, 1);
-
-  /* Implementation of formula in Section B.4. */
-  if (timer_ticks () % TIMER_FREQ == 0)
-    {
-      for (e = list_begin (&all_list); e != list_end (&all_list);
-            e = list_next (e))
-      {
-        t = list_entry (e, struct thread, allelem);
-        /* Fixed-point implmentation of formula:
-           recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice. */
-        struct fixed_point multiplier = fixed_point_get_copied (&load_avg);
-        fixed_point_multiply_int (&multiplier, 2);
-
-        struct fixed_point divisor = fixed_point_get_copied (&multiplier);
-        fixed_point_add_int (&divisor, 1);
-
-        fixed_point_multiply (&t->recent_cpu, &multiplier);
-        fixed_point_divide (&t->recent_cpu, &divisor);
-        fixed_point_add_int (&t->recent_cpu, t->nice);
-      }
-
-      /* ready_threads is the number of threads that are either running
-         or ready to run at time of update (not including the idle thread). */
-      int ready_threads = (int) list_size (&ready_list);
-      if (cur != idle_thread)
-        ++ready_threads;
-
-      /* Fixed-point implmentation of formula:
-         load_avg = (59/60)*load_avg + (1/60)*ready_threads.  */
-      fixed_point_multiply_int (&load_avg, 59);
-      fixed_point_add_int (&load_avg, ready_threads);
-      fixed_point_divide_int (&load_avg, 60);
-    }
+  if (thread_mlfqs)
+    mlfqs_tick (cur);
 
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
@@ -215,6 +246,47 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  if (thread_mlfqs)
+    printf ("MLFQS: %lld per-second updates, %lld recent_cpu decays\n",
+            mlfqs_sweeps, mlfqs_decays);
+}
+
+/* Stores the accounting of up to MAX threads, other than the
+   idle thread, into STATS and returns the number stored. */
+int
+thread_get_stats (struct procstat *stats, int max)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+  int cnt = 0;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&all_list); e != list_end (&all_list) && cnt < max;
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct procstat *s = &stats[cnt];
+
+      if (t == idle_thread)
+        continue;
+      s->pid = t->tid;
+      strlcpy (s->name, t->name, sizeof s->name);
+      s->state = (t->status == THREAD_RUNNING ? 'R'
+                  : t->status == THREAD_READY ? 'E' : 'B');
+      s->priority = get_thread_priority (t);
+      s->user_ticks = t->user_ticks;
+      s->kernel_ticks = t->kernel_ticks;
+      s->voluntary_switches = t->voluntary_switches;
+      s->involuntary_switches = t->involuntary_switches;
+      s->page_faults = t->page_faults;
+      s->resident_pages = t->resident_pages;
+      s->bytes_read = t->bytes_read;
+      s->bytes_written = t->bytes_written;
+      cnt++;
+    }
+  intr_set_level (old_level);
+
+  return cnt;
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -293,6 +365,7 @@ thread_block (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   thread_current ()->status = THREAD_BLOCKED;
+  sched_trace (SCHED_TRACE_BLOCK, thread_current ()->tid, 0);
   schedule ();
 }
 
@@ -313,8 +386,13 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  if (thread_mlfqs)
+    mlfqs_catch_up (t);
+  ready_queue_push (t, get_thread_priority (t));
   t->status = THREAD_READY;
+  if (sched_trace_enabled)
+    t->ready_since = timer_usecs ();
+  sched_trace (SCHED_TRACE_WAKEUP, t->tid, t->ready_priority);
   intr_set_level (old_level);
 }
 
@@ -369,8 +447,8 @@ thread_exit (void)
     }
 
 #ifdef VM
-  frame_table_exit_thread ();
   mmap_table_exit_thread ();
+  suppl_page_table_exit_thread ();
 #endif
 
 #ifdef USERPROG
@@ -409,23 +487,243 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+    {
+      /* Its recent_cpu may have grown since the last fourth
+         tick; requeue it at the priority that gives. */
+      if (thread_mlfqs)
+        mlfqs_catch_up (cur);
+      ready_queue_push (cur, get_thread_priority (cur));
+    }
   cur->status = THREAD_READY;
+  if (sched_trace_enabled)
+    cur->ready_since = timer_usecs ();
   schedule ();
   intr_set_level (old_level);
 }
 
+/* Puts the current thread to sleep until timer tick
+   SLEEP_UNTIL.  Returns at once if that tick has already come. */
 void
 thread_sleep (int64_t sleep_until)
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
 
+  ASSERT (!intr_context ());
+
   old_level = intr_disable ();
+  if (sleep_until > timer_ticks ())
+    {
+      cur->sleep_until = sleep_until;
+      list_insert_ordered (&sleep_wheel[sleep_until % SLEEP_WHEEL_SIZE],
+                           &cur->sleep_elem, sleep_less, NULL);
+      thread_block ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Blocks the current thread, which the caller has already put
+   on some wait list through its elem, until another thread
+   unblocks it or timer tick DEADLINE comes, whichever is first.
+   In the second case the thread is taken off the wait list
+   before it is woken.  Returns true if it was unblocked, false
+   if the deadline came first.
+
+   Interrupts must be off, as for thread_block(). */
+bool
+thread_block_until (int64_t deadline)
+{
+  struct thread *cur = thread_current ();
 
-  cur->sleep_until = sleep_until;
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (deadline <= timer_ticks ())
+    {
+      list_remove (&cur->elem);
+      return false;
+    }
+
+  cur->sleep_until = deadline;
+  cur->timed_wait = true;
+  cur->timed_out = false;
+  list_insert_ordered (&sleep_wheel[deadline % SLEEP_WHEEL_SIZE],
+                       &cur->sleep_elem, sleep_less, NULL);
   thread_block ();
+  cur->timed_wait = false;
+
+  /* Woken before the deadline: take ourselves off the wheel. */
+  if (cur->sleep_until != INT64_MAX)
+    {
+      list_remove (&cur->sleep_elem);
+      cur->sleep_until = INT64_MAX;
+    }
+  return !cur->timed_out;
+}
+
+/* Returns true if thread A wakes up before thread B.  Threads
+   that wake up at the same tick keep the order they went to
+   sleep in. */
+static bool
+sleep_less (const struct list_elem *a_, const struct list_elem *b_,
+            void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, sleep_elem);
+  const struct thread *b = list_entry (b_, struct thread, sleep_elem);
+
+  return a->sleep_until < b->sleep_until;
+}
+
+/* Moves T, if it is ready to run, to the run queue for its
+   current priority, or, if it is blocked on a semaphore, to its
+   place among the semaphore's waiters, which are kept in
+   priority order.  Must be called whenever something other than
+   T itself changes T's priority, such as a donation or an MLFQS
+   recomputation. */
+void
+thread_requeue (struct thread *t)
+{
+  enum intr_level old_level;
+  int priority;
+
+  ASSERT (is_thread (t));
+
+  old_level = intr_disable ();
+  if (t->status == THREAD_READY)
+    {
+      priority = get_thread_priority (t);
+      if (priority != t->ready_priority)
+        {
+          ready_queue_remove (t);
+          ready_queue_push (t, priority);
+        }
+    }
+  else if (t->status == THREAD_BLOCKED && t->waiting_sema != NULL)
+    {
+      list_remove (&t->elem);
+      list_insert_ordered (&t->waiting_sema->waiters, &t->elem,
+                           thread_priority_greater, NULL);
+    }
+  intr_set_level (old_level);
+}
+
+/* Donates DONOR's effective priority, now that DONOR is waiting
+   for a lock, to the lock's holder, and from there down the
+   chain of threads each waiting for a lock held by the next, for
+   at most thread_donation_depth locks.  A writer waiting for the
+   readers of a reader/writer lock to leave donates to each of
+   them.  Stops early at a thread whose priority is already at
+   least as high. */
+void
+thread_donate_priority (struct thread *donor)
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (donor));
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  donate_from (donor, 0);
+  intr_set_level (old_level);
+}
+
+/* Does the work of thread_donate_priority() for DONOR, whose
+   donation has already passed through DEPTH locks.  Follows a
+   chain of locks by iterating and the readers of a reader/writer
+   lock by recursing, so the recursion is only as deep as the
+   chain has reader/writer locks. */
+static void
+donate_from (struct thread *donor, int depth)
+{
+  int priority = donor->effective_priority;
+  struct list_elem *e;
+
+  for (; depth < thread_donation_depth; depth++)
+    {
+      struct lock *lock = donor->waiting_lock;
+      struct rwlock *rw = donor->waiting_rwlock;
+
+      if (lock != NULL && lock->holder != NULL)
+        {
+          if (!donate_to (lock->holder, priority))
+            break;
+          donor = lock->holder;
+        }
+      else
+        {
+          if (rw != NULL)
+            for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+                 e = list_next (e))
+              {
+                struct thread *t = list_entry (e, struct read_hold, elem)->thread;
+                if (donate_to (t, priority))
+                  donate_from (t, depth + 1);
+              }
+          break;
+        }
+    }
+}
+
+/* Raises T's effective priority to PRIORITY.  Returns false,
+   without doing anything, if it is already at least as high. */
+static bool
+donate_to (struct thread *t, int priority)
+{
+  if (t->effective_priority >= priority)
+    return false;
+  t->effective_priority = priority;
+  thread_requeue (t);
+  sched_trace (SCHED_TRACE_DONATE, t->tid, t->effective_priority);
+  return true;
+}
+
+/* Recomputes T's effective priority from its own priority and
+   the donations of the threads waiting for locks that T holds,
+   and of the writers waiting for T to leave reader/writer locks,
+   after T's priority changed or T gave up a lock.  Those threads'
+   effective priorities already include whatever was donated to
+   them, so this only looks one level deep, and since waiters are
+   kept in priority order only at the first waiter of each
+   lock. */
+void
+thread_refresh_priority (struct thread *t)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+  int priority;
+  int i;
+
+  ASSERT (is_thread (t));
+
+  old_level = intr_disable ();
+  priority = t->priority;
+  for (e = list_begin (&t->acquired_lock_list);
+       e != list_end (&t->acquired_lock_list); e = list_next (e))
+    {
+      struct list *waiters = &list_entry (e, struct lock, elem)->semaphore.waiters;
 
+      if (!list_empty (waiters))
+        {
+          struct thread *waiter = list_entry (list_front (waiters),
+                                              struct thread, elem);
+          if (waiter->effective_priority > priority)
+            priority = waiter->effective_priority;
+        }
+    }
+  for (i = 0; i < THREAD_READ_HOLD_CNT; i++)
+    {
+      /* A writer waiting for readers to leave holds the write
+         lock while it waits. */
+      struct rwlock *rw = t->read_holds[i].rwlock;
+
+      if (rw != NULL && rw->writer_waiting
+          && rw->write_lock.holder->effective_priority > priority)
+        priority = rw->write_lock.holder->effective_priority;
+    }
+  t->effective_priority = priority;
+  thread_requeue (t);
   intr_set_level (old_level);
 }
 
@@ -451,26 +749,17 @@ thread_foreach (thread_action_func *func, void *aux)
 void
 thread_set_priority (int new_priority) 
 {
-  struct list_elem *e;
-  bool should_yield = false;
+  enum intr_level old_level;
+  bool should_yield;
 
+  old_level = intr_disable ();
   thread_current ()->priority = new_priority;
-  int current_thread_priority = thread_get_priority ();
-
-  for (e = list_begin (&ready_list); e != list_end (&ready_list);
-       e = list_next (e))
-    {
-      struct thread *t = list_entry (e, struct thread, elem);
-      int priority = get_thread_priority (t);
-      if (priority > current_thread_priority)
-        {
-          should_yield = true;
-          break;
-        }
-    }
+  thread_refresh_priority (thread_current ());
+  should_yield = ready_queue_max_priority () > thread_get_priority ();
+  intr_set_level (old_level);
 
   if (should_yield)
-    thread_yield();
+    thread_yield ();
 }
 
 /* Returns the current thread's priority with priority-donation taken into account. */
@@ -484,7 +773,18 @@ thread_get_priority (void)
 void
 thread_set_nice (int nice) 
 {
-  thread_current ()->nice = nice;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool should_yield;
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  mlfqs_update_priority (cur);
+  should_yield = ready_queue_max_priority () > thread_get_priority ();
+  intr_set_level (old_level);
+
+  if (should_yield)
+    thread_yield ();
 }
 
 /* Returns the current thread's nice value. */
@@ -498,16 +798,15 @@ thread_get_nice (void)
 int
 thread_get_recent_cpu (void) 
 {
-  struct fixed_point recent_cpu_times_hundred = fixed_point_get_multiplied_int(&thread_current ()->recent_cpu, 100);
-  return fixed_point_to_int (&recent_cpu_times_hundred);
+  return fixed_point_round (
+    fixed_point_multiply_int (thread_current ()->recent_cpu, 100));
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  struct fixed_point load_avg_times_hundred = fixed_point_get_multiplied_int(&load_avg, 100);
-  return fixed_point_to_int(&load_avg_times_hundred);
+  return fixed_point_round (fixed_point_multiply_int (load_avg, 100));
 }
 
 struct thread *thread_find (tid_t tid)
@@ -602,6 +901,7 @@ static void
 init_thread (struct thread *t, const char *name, int priority)
 {
   enum intr_level old_level;
+  int i;
 
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
@@ -612,9 +912,17 @@ init_thread (struct thread *t, const char *name, int priority)
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
+  t->effective_priority = priority;
+  t->mlfqs_priority = mlfqs_compute_priority (t);
+  t->decayed_at = decay_seconds;
   t->sleep_until = INT64_MAX;
   list_init(&t->acquired_lock_list);
+  for (i = 0; i < THREAD_READ_HOLD_CNT; i++)
+    t->read_holds[i].thread = t;
   list_init(&t->exit_info_list);
+#ifdef VM
+  list_init (&t->mmaps);
+#endif
   t->magic = THREAD_MAGIC;
 
   old_level = intr_disable ();
@@ -643,27 +951,56 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  int priority = ready_queue_max_priority ();
+  struct thread *t;
+
+  if (priority < PRI_MIN)
     return idle_thread;
 
-  struct list_elem *e;
-  struct thread *max_priority_thread = NULL;
-  int max_priority = PRI_MIN - 1;
+  t = list_entry (list_front (&ready_queues[priority]), struct thread, elem);
+  ready_queue_remove (t);
+  return t;
+}
 
-  for (e = list_begin (&ready_list); e != list_end (&ready_list);
-       e = list_next (e))
-    {
-      struct thread *thread = list_entry (e, struct thread, elem);
-      int priority = get_thread_priority(thread);
-      if (priority > max_priority)
-        {
-          max_priority_thread = thread;
-          max_priority = priority;
-        }
-    }
-  
-  list_remove (&max_priority_thread->elem);
-  return max_priority_thread;
+/* Appends T to the run queue for PRIORITY, which must be T's
+   current priority.  Interrupts must be off. */
+static void
+ready_queue_push (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  t->ready_priority = priority;
+  list_push_back (&ready_queues[priority], &t->elem);
+  ready_bitmap[priority / 32] |= 1u << (priority % 32);
+  ready_cnt++;
+}
+
+/* Removes T from its run queue.  Interrupts must be off. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  int priority = t->ready_priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[priority]))
+    ready_bitmap[priority / 32] &= ~(1u << (priority % 32));
+  ready_cnt--;
+}
+
+/* Returns the highest priority of any ready thread, or
+   PRI_MIN - 1 if no thread is ready.  Interrupts must be off. */
+static int
+ready_queue_max_priority (void)
+{
+  int i;
+
+  for (i = READY_BITMAP_WORDS - 1; i >= 0; i--)
+    if (ready_bitmap[i] != 0)
+      return i * 32 + 31 - __builtin_clz (ready_bitmap[i]);
+  return PRI_MIN - 1;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -731,7 +1068,16 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      if (cur->status == THREAD_READY)
+        cur->involuntary_switches++;
+      else
+        cur->voluntary_switches++;
+      if (sched_trace_enabled && next != idle_thread)
+        sched_trace_ready_latency (next, timer_usecs () - next->ready_since);
+      sched_trace (SCHED_TRACE_SWITCH, next->tid, cur->tid);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
@@ -742,9 +1088,9 @@ allocate_tid (void)
   static tid_t next_tid = 1;
   tid_t tid;
 
-  lock_acquire (&tid_lock);
+  mutex_acquire (&tid_lock);
   tid = next_tid++;
-  lock_release (&tid_lock);
+  mutex_release (&tid_lock);
 
   return tid;
 }
@@ -756,47 +1102,147 @@ get_thread_priority (struct thread *t)
   return thread_mlfqs ? get_thread_priority_mlfqs(t) : get_thread_priority_default(t);
 }
 
+/* Returns true if the thread with list element A has a higher
+   priority than the one with B.  Used to keep semaphore waiters
+   in priority order, highest first, and in arrival order among
+   equal priorities. */
+bool
+thread_priority_greater (const struct list_elem *a_,
+                         const struct list_elem *b_, void *aux UNUSED)
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return get_thread_priority ((struct thread *) a)
+         > get_thread_priority ((struct thread *) b);
+}
+
+/* Returns T's priority including donations, which
+   thread_donate_priority() and thread_refresh_priority() keep
+   up to date. */
 int
 get_thread_priority_default (struct thread *t)
 {
-  int priority = t->priority;
-  struct list_elem *e;
-  struct list_elem *ee;
-  struct list *acquired_lock_list = &t->acquired_lock_list;
+  return t->effective_priority;
+}
 
-  for (e = list_begin (acquired_lock_list); e != list_end (acquired_lock_list);
-       e = list_next (e))
-    {
-      struct lock *l = list_entry (e, struct lock, elem);
-      struct list *waiters = &l->semaphore.waiters;
+/* Returns T's MLFQS priority, which mlfqs_update_priority()
+   keeps up to date. */
+int
+get_thread_priority_mlfqs (struct thread *t)
+{
+  return t->mlfqs_priority;
+}
+
+/* MLFQS bookkeeping for the timer tick, with CUR the running
+   thread.  Only CUR's recent_cpu changes from tick to tick, so
+   only its priority is recomputed every fourth tick, and again
+   by thread_yield() when it goes back to the run queue; once per
+   second, recent_cpu is decayed for CUR and the ready threads
+   and the load average is updated.  Implements the formulas of
+   Section B.3 and B.4. */
+static void
+mlfqs_tick (struct thread *cur)
+{
+  int64_t ticks = timer_ticks ();
+  struct fixed_point factor;
+  struct list_elem *e, *next;
+  int ready_threads;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
 
-      for (ee = list_begin (waiters); ee != list_end (waiters);
-           ee = list_next (ee))
+  /* On each timer tick, the running thread's recent_cpu is incremented by 1. */
+  if (cur != idle_thread)
+    cur->recent_cpu = fixed_point_add_int (cur->recent_cpu, 1);
+
+  if (ticks % TIMER_FREQ == 0)
+    {
+      /* Fixed-point implmentation of formula:
+         recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice.
+         The factor is the same for every thread, so compute it
+         once. */
+      factor = fixed_point_multiply_int (load_avg, 2);
+      factor = fixed_point_divide (factor, fixed_point_add_int (factor, 1));
+      decay_factors[decay_seconds % DECAY_HISTORY] = factor;
+      decay_seconds++;
+      mlfqs_sweeps++;
+
+      if (decay_seconds % DECAY_HISTORY == 0)
         {
-          /* Iterate through every thread waiting due to the locks the current thread has acquired.
-             Have the waiting threads to donate their priority to the current thread. */
-          struct thread *waiter_thread = list_entry (ee, struct thread, elem);
-          int waiter_thread_priority = get_thread_priority (waiter_thread);
-          if (waiter_thread_priority > priority)
-            priority = waiter_thread_priority;
+          for (e = list_begin (&all_list); e != list_end (&all_list);
+               e = list_next (e))
+            mlfqs_catch_up (list_entry (e, struct thread, allelem));
         }
+      else
+        {
+          /* A thread whose priority changes moves to another
+             queue, which may be visited again, harmlessly, since
+             it is already caught up. */
+          for (i = PRI_MAX; i >= PRI_MIN; i--)
+            for (e = list_begin (&ready_queues[i]);
+                 e != list_end (&ready_queues[i]); e = next)
+              {
+                next = list_next (e);
+                mlfqs_catch_up (list_entry (e, struct thread, elem));
+              }
+          mlfqs_catch_up (cur);
+        }
+
+      /* ready_threads is the number of threads that are either running
+         or ready to run at time of update (not including the idle thread). */
+      ready_threads = (int) ready_cnt;
+      if (cur != idle_thread)
+        ++ready_threads;
+
+      /* Fixed-point implmentation of formula:
+         load_avg = (59/60)*load_avg + (1/60)*ready_threads.  */
+      load_avg = fixed_point_divide_int (
+        fixed_point_add_int (fixed_point_multiply_int (load_avg, 59),
+                             ready_threads), 60);
     }
-  return priority;
+  else if (ticks % TIME_SLICE == 0)
+    mlfqs_update_priority (cur);
 }
 
-int
-get_thread_priority_mlfqs (struct thread *t)
+/* Applies to T's recent_cpu the per-second decays it has missed,
+   then recomputes its priority. */
+static void
+mlfqs_catch_up (struct thread *t)
+{
+  while (t->decayed_at < decay_seconds)
+    {
+      t->recent_cpu = fixed_point_add_int (
+        fixed_point_multiply (t->recent_cpu,
+                              decay_factors[t->decayed_at % DECAY_HISTORY]),
+        t->nice);
+      t->decayed_at++;
+      mlfqs_decays++;
+    }
+  mlfqs_update_priority (t);
+}
+
+/* Recomputes T's MLFQS priority and moves T to the matching run
+   queue if it is ready. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  t->mlfqs_priority = mlfqs_compute_priority (t);
+  thread_requeue (t);
+}
+
+static int
+mlfqs_compute_priority (struct thread *t)
 {
   /* Implementation of the below formula at Section B.2:
      priority = PRI_MAX - (recent_cpu / 4) - (nice * 2).
      400 instead of 4 since recent_cpu here is 100 times
      the recent_cpu of Section B.2. */
-  struct fixed_point priority_fp = fixed_point_create (PRI_MAX);
-  struct fixed_point divided_recent_cpu = fixed_point_get_divided_int (&t->recent_cpu, 4);
-  fixed_point_substract (&priority_fp, &divided_recent_cpu);
-  fixed_point_add_int (&priority_fp, -(t->nice * 2));
+  struct fixed_point priority_fp =
+    fixed_point_subtract (fixed_point_create (PRI_MAX - t->nice * 2),
+                          fixed_point_divide_int (t->recent_cpu, 4));
 
-  int priority = fixed_point_to_int (&priority_fp);
+  int priority = fixed_point_to_int (priority_fp);
   if (priority < PRI_MIN)
     return PRI_MIN;
   if (priority > PRI_MAX)
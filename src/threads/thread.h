@@ -6,6 +6,10 @@
 #include <stdint.h>
 #include "threads/fixed-point.h"
 
+struct lock;
+struct rwlock;
+struct semaphore;
+
 /* States in a thread's life cycle. */
 enum thread_status
   {
@@ -82,6 +86,20 @@ struct thread_exit_info
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
+/* Maximum number of reader/writer locks that a thread may hold
+   for reading at once. */
+#define THREAD_READ_HOLD_CNT 4
+
+/* A thread's hold on a reader/writer lock for reading.  While in
+   use, it is an element in the lock's list of readers, through
+   which a waiting writer donates its priority (synch.c). */
+struct read_hold
+  {
+    struct rwlock *rwlock;              /* Lock held, or NULL if unused. */
+    struct thread *thread;              /* Thread holding it. */
+    struct list_elem elem;              /* Element in the lock's readers. */
+  };
+
 /* The `elem' member has a dual purpose.  It can be an element in
    the run queue (thread.c), or it can be an element in a
    semaphore wait list (synch.c).  It can be used these two ways
@@ -96,20 +114,54 @@ struct thread
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
+    int effective_priority;             /* Priority with donations. */
+    int ready_priority;                 /* Run queue, while THREAD_READY. */
+    int64_t ready_since;                /* When put in the run queue, in us, if tracing. */
     int64_t sleep_until;                /* When to wake up in ticks. Set as INT64_MAX when not sleeping. */
+    struct list_elem sleep_elem;        /* List element for the sleep wheel. */
+    bool timed_wait;                    /* Blocked in thread_block_until()? */
+    bool timed_out;                     /* Woken by its deadline? */
     int nice;
     struct fixed_point recent_cpu;      /* recent_cpu of Section B.3. */
+    int decayed_at;                     /* Per-second updates applied to recent_cpu. */
+    int mlfqs_priority;                 /* Priority under the MLFQS. */
     struct list_elem allelem;           /* List element for all threads list. */
 
+    /* Accounting, reported by thread_get_stats(). */
+    int64_t user_ticks;                 /* Timer ticks in user mode. */
+    int64_t kernel_ticks;               /* Timer ticks in kernel mode. */
+    unsigned voluntary_switches;        /* # of times blocked or exited. */
+    unsigned involuntary_switches;      /* # of times preempted or yielded. */
+    unsigned page_faults;               /* # of page faults. */
+    unsigned resident_pages;            /* User pages in memory. */
+    int64_t bytes_read;                 /* Bytes read through read(). */
+    int64_t bytes_written;              /* Bytes written through write(). */
+
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;
 
     /* List of locks this thread has acquired. */
     struct list acquired_lock_list;
+    /* Lock this thread is blocked acquiring, or NULL. */
+    struct lock *waiting_lock;
+    /* Semaphore this thread is blocked on, or NULL. */
+    struct semaphore *waiting_sema;
+    /* Reader/writer locks this thread holds for reading. */
+    struct read_hold read_holds[THREAD_READ_HOLD_CNT];
+    /* Reader/writer lock this thread, as a writer, waits for
+       readers to leave, or NULL. */
+    struct rwlock *waiting_rwlock;
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+#endif
+#ifdef VM
+    /* Owned by vm/suppl_page_table.c. */
+    struct hash *pages;                 /* Supplemental page table. */
+
+    /* Owned by vm/mmap_table.c. */
+    struct list mmaps;                  /* Mapped files. */
 #endif
     struct file *file;                  /* Prevents writing to this file. */
 
@@ -125,12 +177,17 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+extern int thread_donation_depth;
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
 
+struct procstat;
+int thread_get_stats (struct procstat *, int max);
+
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
@@ -145,11 +202,19 @@ void thread_exit (void) NO_RETURN;
 void thread_try_yield (void);
 void thread_yield (void);
 void thread_sleep (int64_t sleep_until);
+bool thread_block_until (int64_t deadline);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+void thread_requeue (struct thread *);
+void thread_donate_priority (struct thread *donor);
+void thread_refresh_priority (struct thread *);
+int get_thread_priority (struct thread *);
+bool thread_priority_greater (const struct list_elem *,
+                              const struct list_elem *, void *aux);
+
 int thread_get_priority (void);
 void thread_set_priority (int);
 
@@ -1,6 +1,7 @@
 #include "userprog/exception.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include "filesys/fs-cache.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
@@ -11,10 +12,7 @@
 #include "threads/vaddr.h"
 
 #ifdef VM
-#include "vm/frame_table.h"
-#include "vm/mmap_table.h"
 #include "vm/suppl_page_table.h"
-#include "vm/swap_table.h"
 #endif
 
 /* Number of page faults processed. */
@@ -154,6 +152,7 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  thread_current ()->page_faults++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
@@ -171,11 +170,15 @@ page_fault (struct intr_frame *f)
   //         write ? "writing" : "reading",
   //         user ? "user" : "kernel");
 
-  /* Swap in the page if the page exists in the swap table. */
-  if (swap_table_find (thread_tid (), pg_round_down (fault_addr)) != NULL)
+  /* Bring in the page if it belongs to the process but is not in
+     memory. */
+  struct page *page = suppl_page_table_find (fault_addr);
+  if (page != NULL)
     {
-      frame_table_reinstall (pg_round_down (fault_addr));
-      return;
+      if (not_present && suppl_page_table_load (page))
+        return;
+      syscall_exit (-1);
+      NOT_REACHED ();
     }
 
   /* Exit if fault_addr is too low, reaching under the addresses for the code segment. */
@@ -185,35 +188,25 @@ page_fault (struct intr_frame *f)
       NOT_REACHED ();
     }
 
-  /* Install a user virtual page for fault_addr when user is writing and the address belongs to user stack.
+  /* Grow the stack when user is writing and the address belongs to user stack.
      Gives additional 32 bytes of leeway to support stack growth by PUSHA. See 4.3.3 Stack Growth. */
   if (user && write
   && ((uint8_t *) fault_addr) < ((uint8_t *) PHYS_BASE)
   && ((uint8_t *) fault_addr) >= ((uint8_t *) f->esp - 32))
     {
-      /* Install all pages from PHYS_BASE down to fault_addr. */
-      struct thread *t = thread_current ();
+      /* Add all pages from PHYS_BASE down to fault_addr that are
+         not in the page table yet.  They are zeroed when first
+         touched. */
       for (uint8_t *upage = PHYS_BASE - PGSIZE; upage >= (uint8_t *) pg_round_down (fault_addr); upage -= PGSIZE)
-        {
-          if (pagedir_get_page (t->pagedir, upage) != NULL)
-            continue;
-          if (swap_table_find (t->tid, upage) != NULL)
-            continue;
-          frame_table_install (upage, true, true);
-        }
-      
-      return;
-    }
-  
-  if (mmap_table_contains (fault_addr))
-    {
-      uint8_t *upage = pg_round_down (fault_addr);
-      frame_table_install (upage, true, true);
-      mmap_table_fill (upage);
-      /* Set the dirty flag to false here, so later during munmap,
-         pages that were not written on can be found. */
-      pagedir_set_dirty (thread_current ()->pagedir, upage, false);
-      return;
+        if (suppl_page_table_find (upage) == NULL
+            && suppl_page_table_add (upage, PAGE_ZERO, true) == NULL)
+          {
+            syscall_exit (-1);
+            NOT_REACHED ();
+          }
+
+      if (suppl_page_table_load (suppl_page_table_find (fault_addr)))
+        return;
     }
 
   syscall_exit (-1);
@@ -9,6 +9,7 @@
 #include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
+#include "devices/timer.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
@@ -21,7 +22,6 @@
 #include "threads/vaddr.h"
 
 #ifdef VM
-#include "vm/frame_table.h"
 #include "vm/suppl_page_table.h"
 #endif
 
@@ -30,6 +30,10 @@
 /* REQUIRED_PALLOC_AVAILABLE_CAPACITY is set to pass multi-oom. */
 #define REQUIRED_PALLOC_AVAILABLE_CAPACITY 160
 
+/* Executable load statistics, protected by global_filesys_lock. */
+static long long load_cnt;      /* # of load() calls. */
+static int64_t load_ticks;      /* Timer ticks spent in load(). */
+
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static void wait_thread (tid_t tid);
@@ -214,6 +218,13 @@ process_exit (void)
     }
 }
 
+/* Prints executable load statistics. */
+void
+process_print_stats (void)
+{
+  printf ("Exec: %lld loads in %"PRId64" ticks\n", load_cnt, load_ticks);
+}
+
 /* Sets up the CPU for running user code in the current
    thread.
    This function is called on every context switch. */
@@ -313,6 +324,7 @@ load (const char *cmdline, void (**eip) (void), void **esp)
   bool success = false;
   int i;
 
+  int64_t start = timer_ticks ();
   lock_acquire (&global_filesys_lock);
   /* Prepare splitting cmdline into tokens. */
   size_t cmdline_len = strlen(cmdline);
@@ -338,6 +350,10 @@ load (const char *cmdline, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!suppl_page_table_init ())
+    goto done;
+#endif
 
   /* First token contains the file name. */
   const char *file_name = tokened_cmdline;
@@ -490,6 +506,8 @@ load (const char *cmdline, void (**eip) (void), void **esp)
       file_close (file);
     }
 
+  load_cnt++;
+  load_ticks += timer_elapsed (start);
   lock_release (&global_filesys_lock);
   return success;
 }
@@ -567,6 +585,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (lock_held_by_current_thread (&global_filesys_lock));
 
   // printf ("load_segment, read_bytes: %d, zero_bytes: %d, writable: %d\n", read_bytes, zero_bytes, writable);
+#ifdef VM
+  /* Only record the segment.  Each page is read from FILE, or
+     zeroed, by page_fault() when it is first touched. */
+  return suppl_page_table_add_segment (file, ofs, upage, read_bytes,
+                                       zero_bytes, writable);
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -576,20 +600,6 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-#ifdef VM
-      /* Get a page of memory. */
-      uint8_t *kpage = frame_table_install (upage, writable, writable);
-      if (kpage == NULL)
-        return false;
-
-      /* Load this page. */
-      if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
-        {
-          palloc_free_page (kpage);
-          return false;
-        }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
-#else
       /* Get a page of memory. */
       uint8_t *kpage = palloc_get_page (PAL_USER);
       if (kpage == NULL)
@@ -609,7 +619,6 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
-#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
@@ -617,6 +626,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -625,8 +635,10 @@ static bool
 setup_stack (void **esp) 
 {
 #ifdef VM
-  frame_table_install (((uint8_t *) PHYS_BASE) - PGSIZE, true, true);
-  memset (((uint8_t *) PHYS_BASE) - PGSIZE, 0, PGSIZE);
+  struct page *page = suppl_page_table_add (((uint8_t *) PHYS_BASE) - PGSIZE,
+                                            PAGE_ZERO, true);
+  if (page == NULL || !suppl_page_table_load (page))
+    return false;
   *esp = PHYS_BASE;
   return true;
 #else
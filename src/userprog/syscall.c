@@ -1,4 +1,5 @@
 #include "userprog/syscall.h"
+#include <procstat.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall-nr.h>
@@ -6,7 +7,6 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
-#include "filesys/fs-cache.h"
 #include "filesys/inode.h"
 #include "filesys/path.h"
 #include "userprog/pagedir.h"
@@ -60,10 +60,12 @@ static bool handle_mkdir (void *esp);
 static bool handle_readdir (void *esp);
 static bool handle_isdir (void *esp);
 static int handle_inumber (void *esp);
+static int handle_procstat (void *esp);
 
 static uint32_t get_argument (void *esp, size_t idx);
 static int find_available_fd (void);
 static bool is_uaddr_valid (const void *uaddr);
+static void check_user_buffer (void *buffer, size_t size);
 static bool is_fd_for_file (int fd);
 
 typedef void dir_and_filename_func (struct dir *dir, const char *filename, void *aux);
@@ -89,9 +91,6 @@ syscall_exit (int status)
     lock_release (&global_filesys_lock);
 #endif
 
-  if (lock_held_by_current_thread (fs_cache_get_lock ()))
-    lock_release (fs_cache_get_lock ());
-
   /* Pass status to parent. */
   int parent_tid = t->parent_tid;
   if (parent_tid != TID_ERROR)
@@ -200,6 +199,9 @@ syscall_handler (struct intr_frame *f)
         f->eax = handle_inumber (f->esp);
         return;
 #endif
+      case SYS_PROCSTAT:
+        f->eax = handle_procstat (f->esp);
+        return;
     }
   
   printf ("Found a syscall with a number (%d) not implemented yet.\n", number);
@@ -444,11 +446,14 @@ handle_read (void *esp)
       NOT_REACHED ();
     }
 
+  /* Reads are synchronized per sector by the buffer cache, so
+     readers do not take global_filesys_lock and can overlap their
+     disk waits. */
   struct fd_info *fd_info = fd_info_map[fd - FD_BASE];
-  lock_acquire (&global_filesys_lock);
-  int bytes_read = file_read (fd_info->file, buffer, size);
-  lock_release (&global_filesys_lock);
-  return bytes_read;
+  int result = file_read (fd_info->file, buffer, size);
+  if (result > 0)
+    thread_current ()->bytes_read += result;
+  return result;
 }
 
 static int
@@ -466,7 +471,11 @@ handle_write (void *esp)
     }
 
   if (fd == STDOUT_FILENO)
-    return printf ((const char *) buffer);
+    {
+      int result = printf ((const char *) buffer);
+      thread_current ()->bytes_written += result;
+      return result;
+    }
 
   if (!is_fd_for_file (fd))
     {
@@ -482,6 +491,8 @@ handle_write (void *esp)
   else
     result = file_write (fd_info->file, buffer, size);
   lock_release (&global_filesys_lock);
+  if (result > 0)
+    thread_current ()->bytes_written += result;
   return result;
 }
 
@@ -567,12 +578,6 @@ handle_mmap (void *esp)
     return -1;
   if (!is_fd_for_file (fd))
     return -1;
-  if (mmap_table_contains (addr))
-    return -1;
-
-  uint32_t *pd = thread_current ()->pagedir;
-  if (pagedir_get_page (pd, addr) != NULL)
-    return -1;
 
   struct fd_info *fd_info = fd_info_map[fd - FD_BASE];
   lock_acquire (&global_filesys_lock);
@@ -683,6 +688,36 @@ handle_inumber (void *esp)
   return inumber;
 }
 
+static int
+handle_procstat (void *esp)
+{
+  struct procstat *stats = (struct procstat *) get_argument(esp, 1);
+  int max = (int) get_argument(esp, 2);
+  struct procstat *buf;
+  int cnt;
+
+  if (max <= 0)
+    return 0;
+  if ((size_t) max > PGSIZE / sizeof *stats)
+    max = PGSIZE / sizeof *stats;
+
+  /* Exit when the buffer is not entirely in user memory.  This
+     must happen before BUF is allocated, since exiting from the
+     copy below would leak it. */
+  check_user_buffer (stats, max * sizeof *stats);
+
+  /* Gather the statistics with interrupts off into a kernel
+     buffer, then copy them out, which may fault but, after the
+     check above, only to bring a page back in. */
+  buf = malloc (max * sizeof *buf);
+  if (buf == NULL)
+    return -1;
+  cnt = thread_get_stats (buf, max);
+  memcpy (stats, buf, cnt * sizeof *buf);
+  free (buf);
+  return cnt;
+}
+
 static void
 handle_mkdir_dir_and_filename_func (struct dir *dir, const char *filename, void *aux)
 {
@@ -736,6 +771,40 @@ is_uaddr_valid (const void *uaddr)
 #endif
 }
 
+/* Exits unless the SIZE bytes at BUFFER are all in user memory
+   the process may write.  With VM, each page is written once, so
+   that a page that is not present is brought in and an invalid
+   one makes the process exit here. */
+static void
+check_user_buffer (void *buffer, size_t size)
+{
+  uint8_t *upage;
+
+  if (size == 0)
+    return;
+  if (!is_uaddr_valid (buffer)
+      || !is_uaddr_valid ((uint8_t *) buffer + size - 4))
+    {
+      syscall_exit (-1);
+      NOT_REACHED ();
+    }
+
+  for (upage = pg_round_down (buffer);
+       upage < (uint8_t *) buffer + size; upage += PGSIZE)
+    {
+      volatile uint8_t *p = upage < (uint8_t *) buffer ? buffer : upage;
+#ifdef VM
+      *p = *p;
+#else
+      if (pagedir_get_page (thread_current ()->pagedir, (void *) p) == NULL)
+        {
+          syscall_exit (-1);
+          NOT_REACHED ();
+        }
+#endif
+    }
+}
+
 static bool
 is_fd_for_file (int fd)
 {
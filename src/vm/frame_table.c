@@ -1,68 +1,506 @@
 #include "frame_table.h"
+#include <hash.h>
+#include <list.h>
 #include <stdio.h>
-#include "devices/block.h"
-#include "threads/interrupt.h"
+#include "filesys/file.h"
+#include "filesys/fs-cache.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "userprog/pagedir.h"
 #include "vm/suppl_page_table.h"
 #include "vm/swap_table.h"
 
-void *frame_table_install (void *upage, bool swappable, bool writable)
+/* A frame of the user pool, and the page it holds.
+
+   A frame holding a read-only page of an executable is shared by
+   every process running that executable: it has no single owner,
+   but a list of the pages, one per mapping, that map it.  Shared
+   frames are found by the executable's inode and the page's
+   offset in it and number of bytes read from it, since two
+   segments may share a page of the file but read different
+   amounts of it. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of the frame. */
+    struct thread *owner;       /* Thread whose page is here, or NULL. */
+    struct page *page;          /* The page, in OWNER's page table. */
+    bool pinned;                /* Being filled; must not be evicted. */
+
+    /* Shared frames only. */
+    struct inode *inode;        /* Executable, or NULL if not shared. */
+    off_t ofs;                  /* Offset of the page in INODE. */
+    size_t bytes;               /* Bytes of the page read from INODE. */
+    struct list sharers;        /* Pages mapping the frame. */
+    struct hash_elem hash_elem; /* Element in shared_frames. */
+  };
+
+/* One entry per user pool frame, indexed by
+   palloc_user_page_index(). */
+static struct frame *frames;
+static size_t frame_cnt;
+
+/* Eviction uses the clock algorithm: the hand sweeps the frames
+   in order, clearing the accessed bit of each page it passes and
+   taking the first page whose bit was already clear, that is,
+   that has not been touched since the hand last came by. */
+static size_t clock_hand;
+
+/* Shared frames, keyed by inode, offset and bytes. */
+static struct hash shared_frames;
+
+/* Protects the frame table, eviction, and the KPAGE, EVICTING,
+   TYPE and SWAP_SLOT members of resident pages.  It is not held
+   while an evicted page is written out; see evict_frame(). */
+static struct lock frame_lock;
+
+/* Broadcast when a shared frame has been filled. */
+static struct condition frame_filled;
+
+/* Broadcast when an evicted page has been written out. */
+static struct condition frame_evicted;
+
+/* Eviction statistics. */
+static long long swapped_cnt;       /* Pages written to swap. */
+static long long dropped_cnt;       /* Clean pages dropped. */
+static long long written_back_cnt;  /* Mapped pages written to their file. */
+static long long shared_cnt;        /* Page-ins from a shared frame. */
+
+static struct frame *get_frame (void);
+static struct frame *evict_frame (void);
+static bool frame_in_use (const struct frame *);
+static bool frame_is_accessed (struct frame *);
+static void wait_for_eviction (struct page *);
+static void unmap_sharers (struct frame *);
+
+static unsigned frame_hash_func (const struct hash_elem *e, void *aux UNUSED)
 {
-  ASSERT (pg_ofs (upage) == 0);
+  struct frame *f = hash_entry (e, struct frame, hash_elem);
+  return (hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs)
+          ^ hash_int (f->bytes));
+}
 
-  void *kpage = palloc_get_page (PAL_USER);
-  if (kpage == NULL)
+static bool frame_less_func (const struct hash_elem *a,
+                             const struct hash_elem *b,
+                             void *aux UNUSED)
+{
+  struct frame *frame_a = hash_entry (a, struct frame, hash_elem);
+  struct frame *frame_b = hash_entry (b, struct frame, hash_elem);
+  if (frame_a->inode != frame_b->inode)
+    return frame_a->inode < frame_b->inode;
+  if (frame_a->ofs != frame_b->ofs)
+    return frame_a->ofs < frame_b->ofs;
+  return frame_a->bytes < frame_b->bytes;
+}
+
+void frame_table_init (void)
+{
+  size_t i;
+
+  lock_init (&frame_lock);
+  cond_init (&frame_filled);
+  cond_init (&frame_evicted);
+  if (!hash_init (&shared_frames, frame_hash_func, frame_less_func, NULL))
+    PANIC ("not enough memory for the frame table");
+  frame_cnt = palloc_user_page_cnt ();
+  frames = calloc (frame_cnt, sizeof *frames);
+  if (frames == NULL)
+    PANIC ("not enough memory for the frame table");
+  for (i = 0; i < frame_cnt; i++)
     {
-      // TODO: I don't think it is safe to allow interruptions during
-      // swapping. Find a way to swap without interruptions or
-      // prove why it is okay to swap with interruptions.
-      // enum intr_level old_level;
-      // old_level = intr_disable ();
-
-      struct suppl_page_elem *suppl_page_elem = suppl_page_table_pop_swappable ();
-
-      // printf ("suppl_page_elem uninstall tid: %d, upage: %p, kpage: %p\n",
-      //         suppl_page_elem_get_tid (suppl_page_elem),
-      //         suppl_page_elem_get_upage (suppl_page_elem),
-      //         suppl_page_elem_get_kpage (suppl_page_elem));
-
-      swap_table_insert_and_save (suppl_page_elem_get_tid (suppl_page_elem),
-                                  suppl_page_elem_get_upage (suppl_page_elem),
-                                  suppl_page_elem_get_kpage (suppl_page_elem),
-                                  suppl_page_elem_get_writable(suppl_page_elem));
-      palloc_free_page (suppl_page_elem_get_kpage (suppl_page_elem));
-
-      /* Try again as one of the pages has been swapped. */
-      kpage = palloc_get_page (PAL_USER);
-      // intr_set_level (old_level);
+      frames[i].kpage = palloc_user_page (i);
+      list_init (&frames[i].sharers);
     }
+}
 
-  ASSERT (kpage != NULL);
-  ASSERT (suppl_page_table_add_page(upage, kpage, swappable, writable));
+/* Gets a frame for PAGE of the current process, evicting another
+   page if no frame is free, and maps PAGE to it.  Returns the
+   frame's kernel virtual address.  The frame stays pinned, safe
+   from eviction, until frame_table_unpin() is called on it, so
+   that the caller can fill it first. */
+void *frame_table_install (struct page *page)
+{
+  struct thread *t = thread_current ();
+  struct frame *f;
 
-  // printf ("frame_table_install, tid: %d, upage: %p, kpage: %p, writable: %d\n", thread_current ()->tid, upage, kpage, writable);
+  lock_acquire (&frame_lock);
+  wait_for_eviction (page);
+  ASSERT (page->kpage == NULL);
 
-  return kpage;
+  f = get_frame ();
+  bool mapped = pagedir_set_page (t->pagedir, page->upage, f->kpage,
+                                  page->writable);
+  ASSERT (mapped);
+
+  /* Give the new page a full turn of the clock before it can be
+     evicted. */
+  pagedir_set_accessed (t->pagedir, page->upage, true);
+
+  f->owner = t;
+  f->page = page;
+  f->pinned = true;
+  page->kpage = f->kpage;
+  t->resident_pages++;
+  lock_release (&frame_lock);
+
+  return f->kpage;
+}
+
+/* Like frame_table_install(), for PAGE of the current process,
+   a read-only page of its executable.  If another process
+   already has the same page of the same executable in memory,
+   maps PAGE to that frame, sets *FILL to false and returns the
+   frame unpinned.  Otherwise, gets a new shared frame and sets
+   *FILL to true, and the caller must fill the frame and unpin
+   it. */
+void *frame_table_install_shared (struct page *page, bool *fill)
+{
+  struct thread *t = thread_current ();
+  struct frame key;
+  struct frame *f, *new_frame = NULL;
+
+  ASSERT (page->type == PAGE_FILE && !page->writable);
+
+  key.inode = file_get_inode (page->file);
+  key.ofs = page->file_ofs;
+  key.bytes = page->file_bytes;
+
+  lock_acquire (&frame_lock);
+  ASSERT (page->kpage == NULL);
+
+  /* Wait for a frame being filled by another process.  It may be
+     evicted before we run again, so look it up once more.
+     Getting a new frame may release frame_lock while a victim is
+     written out, and another process may add the frame
+     meanwhile, so look it up again after that too. */
+  for (;;)
+    {
+      struct hash_elem *e = hash_find (&shared_frames, &key.hash_elem);
+      if (e != NULL)
+        {
+          f = hash_entry (e, struct frame, hash_elem);
+          if (!f->pinned)
+            break;
+          cond_wait (&frame_filled, &frame_lock);
+        }
+      else if (new_frame == NULL)
+        {
+          new_frame = get_frame ();
+          new_frame->pinned = true;
+        }
+      else
+        {
+          f = NULL;
+          break;
+        }
+    }
+
+  *fill = f == NULL;
+  if (f != NULL)
+    {
+      if (new_frame != NULL)
+        {
+          new_frame->pinned = false;
+          palloc_free_page (new_frame->kpage);
+        }
+      shared_cnt++;
+    }
+  else
+    {
+      f = new_frame;
+      f->inode = key.inode;
+      f->ofs = key.ofs;
+      f->bytes = key.bytes;
+      hash_insert (&shared_frames, &f->hash_elem);
+    }
+
+  bool mapped = pagedir_set_page (t->pagedir, page->upage, f->kpage, false);
+  ASSERT (mapped);
+  pagedir_set_accessed (t->pagedir, page->upage, true);
+
+  list_push_back (&f->sharers, &page->share_elem);
+  page->kpage = f->kpage;
+  t->resident_pages++;
+  lock_release (&frame_lock);
+
+  return f->kpage;
 }
 
-void *frame_table_reinstall (void *upage)
+/* Allows the frame at KPAGE, filled since frame_table_install()
+   or frame_table_install_shared(), to be evicted. */
+void frame_table_unpin (void *kpage)
 {
-  ASSERT (pg_ofs (upage) == 0);
+  struct frame *f = &frames[palloc_user_page_index (kpage)];
 
-  struct swap_table_elem *swap_table_elem = swap_table_find (thread_tid (), upage);
-  ASSERT (swap_table_elem != NULL);
+  lock_acquire (&frame_lock);
+  f->pinned = false;
+  if (f->inode != NULL)
+    cond_broadcast (&frame_filled, &frame_lock);
+  lock_release (&frame_lock);
+}
+
+/* Unmaps the shared frame at KPAGE, which the current process
+   got from frame_table_install_shared() but could not fill, and
+   frees it.  Processes waiting for it to be filled look it up
+   again and try to fill a frame themselves. */
+void frame_table_free_shared (void *kpage)
+{
+  struct frame *f = &frames[palloc_user_page_index (kpage)];
 
-  void *kpage = frame_table_install (upage, true, swap_table_elem_is_writable (swap_table_elem));
-  swap_table_load_and_remove (swap_table_elem, kpage);
+  lock_acquire (&frame_lock);
+  ASSERT (f->inode != NULL && f->pinned);
+  unmap_sharers (f);
+  hash_delete (&shared_frames, &f->hash_elem);
+  f->inode = NULL;
+  f->pinned = false;
+  palloc_free_page (kpage);
+  cond_broadcast (&frame_filled, &frame_lock);
+  lock_release (&frame_lock);
+}
 
-  // printf ("frame_table_reinstall, tid: %d, upage: %p, kpage: %p\n", thread_current ()->tid, upage, kpage);
+/* If PAGE of the current process is in memory, pins its frame
+   and returns the frame's kernel virtual address.  Otherwise,
+   returns a null pointer. */
+void *frame_table_pin (struct page *page)
+{
+  lock_acquire (&frame_lock);
+  wait_for_eviction (page);
+  void *kpage = page->kpage;
+  if (kpage != NULL)
+    frames[palloc_user_page_index (kpage)].pinned = true;
+  lock_release (&frame_lock);
 
   return kpage;
 }
 
-void frame_table_exit_thread (void)
+/* Unmaps the page in the pinned frame at KPAGE from the current
+   process and frees the frame. */
+void frame_table_free (void *kpage)
+{
+  struct frame *f = &frames[palloc_user_page_index (kpage)];
+
+  lock_acquire (&frame_lock);
+  ASSERT (f->owner == thread_current () && f->pinned);
+  pagedir_clear_page (f->owner->pagedir, f->page->upage);
+  f->owner->resident_pages--;
+  f->page->kpage = NULL;
+  f->owner = NULL;
+  f->page = NULL;
+  f->pinned = false;
+  palloc_free_page (kpage);
+  lock_release (&frame_lock);
+}
+
+/* Detaches PAGE of the current process, which is exiting, from
+   its frame, if it has one.  The frame itself is freed along
+   with the page directory.  Returns true if PAGE was in
+   memory. */
+bool frame_table_forget (struct page *page)
 {
-  suppl_page_table_exit_thread ();
+  bool resident;
+
+  lock_acquire (&frame_lock);
+  wait_for_eviction (page);
+  resident = page->kpage != NULL;
+  if (resident)
+    {
+      struct frame *f = &frames[palloc_user_page_index (page->kpage)];
+      if (f->inode != NULL)
+        {
+          /* Unmap a shared frame now, so that it is not freed with
+             the page directory, and free it when the last process
+             mapping it goes away.  It cannot be kept for later,
+             because the executable may be written once no process
+             runs it. */
+          pagedir_clear_page (thread_current ()->pagedir, page->upage);
+          list_remove (&page->share_elem);
+          if (list_empty (&f->sharers))
+            {
+              hash_delete (&shared_frames, &f->hash_elem);
+              f->inode = NULL;
+              palloc_free_page (f->kpage);
+            }
+        }
+      else
+        {
+          f->owner = NULL;
+          f->page = NULL;
+        }
+      page->kpage = NULL;
+    }
+  lock_release (&frame_lock);
+
+  return resident;
+}
+
+/* Prints eviction statistics. */
+void frame_table_print_stats (void)
+{
+  printf ("Eviction: %lld pages swapped, %lld clean pages dropped, "
+          "%lld pages written back\n",
+          swapped_cnt, dropped_cnt, written_back_cnt);
+  printf ("Sharing: %lld page-ins from shared frames\n", shared_cnt);
+}
+
+/* Returns a free frame, evicting a page if there is none, in
+   which case frame_lock is released for a while. */
+static struct frame *get_frame (void)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  /* Prefer taking memory back from the buffer cache to
+     swapping.  The cache only gives back clean slabs, so this
+     does not wait for the disk with frame_lock held. */
+  void *kpage = palloc_get_page (PAL_USER);
+  if (kpage == NULL && fs_cache_shrink ())
+    kpage = palloc_get_page (PAL_USER);
+  if (kpage != NULL)
+    return &frames[palloc_user_page_index (kpage)];
+  return evict_frame ();
+}
+
+/* Returns true if F holds a page. */
+static bool frame_in_use (const struct frame *f)
+{
+  return f->owner != NULL || f->inode != NULL;
+}
+
+/* Returns true if the page in F has been accessed through any of
+   its mappings since the clock hand last came by, and clears the
+   accessed bits for the next turn. */
+static bool frame_is_accessed (struct frame *f)
+{
+  bool accessed = false;
+
+  if (f->inode == NULL)
+    {
+      uint32_t *pd = f->owner->pagedir;
+      accessed = pagedir_is_accessed (pd, f->page->upage);
+      pagedir_set_accessed (pd, f->page->upage, false);
+    }
+  else
+    {
+      struct list_elem *e;
+      for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+           e = list_next (e))
+        {
+          struct page *page = list_entry (e, struct page, share_elem);
+          uint32_t *pd = page->owner->pagedir;
+          accessed |= pagedir_is_accessed (pd, page->upage);
+          pagedir_set_accessed (pd, page->upage, false);
+        }
+    }
+  return accessed;
+}
+
+/* Unmaps the shared frame F from every page that maps it. */
+static void unmap_sharers (struct frame *f)
+{
+  while (!list_empty (&f->sharers))
+    {
+      struct page *page = list_entry (list_pop_front (&f->sharers),
+                                      struct page, share_elem);
+      pagedir_clear_page (page->owner->pagedir, page->upage);
+      page->owner->resident_pages--;
+      page->kpage = NULL;
+    }
+}
+
+/* Waits until PAGE, of the current process, is no longer being
+   written out by an eviction. */
+static void wait_for_eviction (struct page *page)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  while (page->evicting)
+    cond_wait (&frame_evicted, &frame_lock);
+}
+
+/* Chooses a page to evict with the clock algorithm, unmaps it,
+   saves it if needed and returns its frame, now free and
+   pinned.  Two turns of the hand are enough to find a victim
+   unless every frame is pinned.
+
+   Only pages whose contents exist nowhere else go to swap: clean
+   zero and executable pages are dropped and brought in again on
+   their next fault, and mapped pages are written back to their
+   file if dirty and then dropped.
+
+   Saving a page releases frame_lock for the disk write, so that
+   other faults are not held up behind it, and so that the write
+   may fault in, through the buffer cache, without frame_lock
+   held.  Meanwhile the frame stays pinned and the page is marked
+   as evicting, and its owner waits in wait_for_eviction() before
+   loading, unmapping or freeing it. */
+static struct frame *evict_frame (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  for (i = 0; i < 2 * frame_cnt; i++)
+    {
+      struct frame *f = &frames[clock_hand];
+      clock_hand = (clock_hand + 1) % frame_cnt;
+
+      if (!frame_in_use (f) || f->pinned || frame_is_accessed (f))
+        continue;
+
+      if (f->inode != NULL)
+        {
+          /* A shared page is read-only, so never dirty. */
+          unmap_sharers (f);
+          hash_delete (&shared_frames, &f->hash_elem);
+          f->inode = NULL;
+          dropped_cnt++;
+          return f;
+        }
+
+      struct page *page = f->page;
+      uint32_t *pd = f->owner->pagedir;
+
+      /* Unmap the page first, so that its owner cannot modify it
+         while it is being saved.  The dirty bit survives. */
+      pagedir_clear_page (pd, page->upage);
+      bool dirty = pagedir_is_dirty (pd, page->upage);
+
+      page->kpage = NULL;
+      f->owner->resident_pages--;
+      f->owner = NULL;
+      f->page = NULL;
+      f->pinned = true;
+
+      if (!dirty && page->type != PAGE_ANON)
+        {
+          dropped_cnt++;
+          return f;
+        }
+
+      page->evicting = true;
+      lock_release (&frame_lock);
+      size_t swap_slot = 0;
+      if (page->type == PAGE_MMAP)
+        file_write_at (page->file, f->kpage, page->file_bytes,
+                       page->file_ofs);
+      else
+        swap_slot = swap_table_out (f->kpage);
+      lock_acquire (&frame_lock);
+
+      if (page->type == PAGE_MMAP)
+        written_back_cnt++;
+      else
+        {
+          /* Once written, a page no longer matches its source. */
+          page->type = PAGE_ANON;
+          page->swap_slot = swap_slot;
+          swapped_cnt++;
+        }
+      page->evicting = false;
+      cond_broadcast (&frame_evicted, &frame_lock);
+      return f;
+    }
+
+  PANIC ("no frame to evict");
 }
@@ -2,10 +2,17 @@
 #define FRAME_TABLE_H
 
 #include <stdbool.h>
-#include <stddef.h>
 
-void *frame_table_install (void *upage, bool swappable, bool writable);
-void *frame_table_reinstall (void *upage);
-void frame_table_exit_thread (void);
+struct page;
+
+void frame_table_init (void);
+void *frame_table_install (struct page *);
+void *frame_table_install_shared (struct page *, bool *fill);
+void frame_table_unpin (void *kpage);
+void frame_table_free_shared (void *kpage);
+void *frame_table_pin (struct page *);
+void frame_table_free (void *kpage);
+bool frame_table_forget (struct page *);
+void frame_table_print_stats (void);
 
 #endif /* vm/frame_table.h */
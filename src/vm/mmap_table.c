@@ -7,144 +7,117 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "vm/frame_table.h"
-#include "vm/swap_table.h"
+#include "vm/suppl_page_table.h"
 
+/* A mapping of a file, in its process's list of mappings.  Its
+   pages are PAGE_MMAP entries of the supplemental page table. */
 struct mmap_elem
   {
     int id;
     struct file *file;
-    int tid;
     void *uaddr;
     int filesize;
     struct list_elem elem;
   };
 
-static int next_mmap_id;
-static struct list mmap_list;
+static int next_mmap_id = 1;
 
-static struct mmap_elem *mmap_table_find (void *uaddr);
-static void mmap_table_update_file (struct mmap_elem *mmap_elem);
-
-void mmap_table_init (void)
-{
-  next_mmap_id = 1;
-  list_init (&mmap_list);
-}
+static void mmap_table_unmap (struct mmap_elem *mmap_elem, int filesize);
 
+/* Maps FILESIZE bytes of FILE at UADDR in the current process.
+   Returns the mapping's identifier, or -1 if the mapping would
+   overlap a page of the process or if out of memory. */
 int mmap_table_add (struct file *file, void *uaddr, int filesize)
 {
   struct mmap_elem *mmap_elem = malloc (sizeof *mmap_elem);
-  mmap_elem->id = next_mmap_id++;
+  if (mmap_elem == NULL)
+    return -1;
   mmap_elem->file = file_reopen (file);
-  mmap_elem->tid = thread_current ()->tid;
+  if (mmap_elem->file == NULL)
+    {
+      free (mmap_elem);
+      return -1;
+    }
   mmap_elem->uaddr = uaddr;
   mmap_elem->filesize = filesize;
-  list_push_back (&mmap_list, &mmap_elem->elem);
+
+  for (int offset = 0; offset < filesize; offset += PGSIZE)
+    {
+      struct page *page = suppl_page_table_add (uaddr + offset, PAGE_MMAP, true);
+      if (page == NULL)
+        {
+          mmap_table_unmap (mmap_elem, offset);
+          file_close (mmap_elem->file);
+          free (mmap_elem);
+          return -1;
+        }
+
+      size_t left_size = filesize - offset;
+      page->file = mmap_elem->file;
+      page->file_ofs = offset;
+      page->file_bytes = left_size < PGSIZE ? left_size : PGSIZE;
+    }
+
+  mmap_elem->id = next_mmap_id++;
+  list_push_back (&thread_current ()->mmaps, &mmap_elem->elem);
   return mmap_elem->id;
 }
 
 void mmap_table_remove (int mapping)
 {
+  struct list *mmaps = &thread_current ()->mmaps;
   struct list_elem *e;
-  for (e = list_begin (&mmap_list); e != list_end (&mmap_list);
-       e = list_next (e)) 
+  for (e = list_begin (mmaps); e != list_end (mmaps); e = list_next (e))
     {
       struct mmap_elem *mmap_elem = list_entry (e, struct mmap_elem, elem);
       if (mmap_elem->id != mapping)
         continue;
 
-      mmap_table_update_file (mmap_elem);
+      mmap_table_unmap (mmap_elem, mmap_elem->filesize);
       file_close (mmap_elem->file);
       list_remove (e);
+      free (mmap_elem);
       return;
     }
 
   NOT_REACHED ();
 }
 
-bool mmap_table_contains (void *uaddr)
-{
-  return mmap_table_find (uaddr) != NULL;
-}
-
-void mmap_table_fill (void *uaddr)
-{
-  struct mmap_elem *mmap_elem = mmap_table_find (uaddr);
-  ASSERT (mmap_elem != NULL);
-
-  uint8_t *upage = pg_round_down (uaddr);
-  file_read_at (mmap_elem->file, upage, PGSIZE, upage - (uint8_t *) mmap_elem->uaddr);
-}
-
 void mmap_table_exit_thread (void)
 {
-  tid_t tid = thread_current ()->tid;
-  struct list_elem *e = list_begin (&mmap_list);
-  while (e != list_end (&mmap_list)) 
+  struct list *mmaps = &thread_current ()->mmaps;
+  while (!list_empty (mmaps))
     {
-      struct mmap_elem *mmap_elem = list_entry (e, struct mmap_elem, elem);
-      if (mmap_elem->tid == tid)
-        {
-          mmap_table_update_file (mmap_elem);
-          file_close (mmap_elem->file);
-          e = list_remove (e);
-        }
-      else
-        {
-          e = list_next (e);
-        }
-    }
-}
-
-static struct mmap_elem *mmap_table_find (void *uaddr)
-{
-  struct thread *t = thread_current ();
-  struct list_elem *e;
-
-  for (e = list_begin (&mmap_list); e != list_end (&mmap_list);
-       e = list_next (e))
-    {
-      struct mmap_elem *mmap_elem = list_entry (e, struct mmap_elem, elem);
-      if (t->tid != mmap_elem->tid)
-        continue;
-      if (uaddr < mmap_elem->uaddr)
-        continue;
-      if (uaddr >= (mmap_elem->uaddr + mmap_elem->filesize))
-        continue;
-      return mmap_elem;
+      struct mmap_elem *mmap_elem = list_entry (list_pop_front (mmaps),
+                                                struct mmap_elem, elem);
+      mmap_table_unmap (mmap_elem, mmap_elem->filesize);
+      file_close (mmap_elem->file);
+      free (mmap_elem);
     }
-  return NULL;
 }
 
-void mmap_table_update_file (struct mmap_elem *mmap_elem)
+/* Writes the dirty pages among the first FILESIZE bytes of
+   MMAP_ELEM back to its file and removes them from the
+   supplemental page table.  Pages that are not in memory were
+   either never touched or already written back by eviction. */
+static void mmap_table_unmap (struct mmap_elem *mmap_elem, int filesize)
 {
-  struct thread *t = thread_current ();
-  uint32_t *pd = t->pagedir;
-  for (int offset = 0; offset < mmap_elem->filesize; offset += PGSIZE)
+  uint32_t *pd = thread_current ()->pagedir;
+  for (int offset = 0; offset < filesize; offset += PGSIZE)
     {
-      // Need to reinstall before starting to writing on file.
-      // Since writing requires acquiring the lock from the ata_disk's channel
-      // in ide_write, we need to do the obtaining beforehands.
-      // Otherwise, since obtaining also requires the lock by going through
-      // ide_read, there is a dead-lock.
-      // It is possible there was no access to some chunk of the file.
-      // In such case, there will be no page available for uaddr and also no
-      // corresponding file found from the swap table. Just move on in this case.
       void *uaddr = mmap_elem->uaddr + offset;
-      if (pagedir_get_page (pd, uaddr) == NULL)
+      struct page *page = suppl_page_table_find (uaddr);
+
+      /* Pin the page, so that it is not evicted while being
+         written back, and write it from its kernel address, so
+         that writing cannot fault. */
+      void *kpage = frame_table_pin (page);
+      if (kpage != NULL)
         {
-          if (swap_table_find (t->tid, uaddr) != NULL)
-            frame_table_reinstall (uaddr);
-          else
-            continue;
+          if (pagedir_is_dirty (pd, uaddr))
+            file_write_at (mmap_elem->file, kpage, page->file_bytes, offset);
+          frame_table_free (kpage);
         }
-      /* Use the dirty flag of the page to detect whether page was written by the
-         user program. This works since the dirty flag was set false after the
-         mmap_table_fill() call in page_fault() of exception.c.*/
-      if (!pagedir_is_dirty (pd, uaddr))
-        continue;
-
-      size_t left_size = mmap_elem->filesize - offset;
-      file_write_at (mmap_elem->file, uaddr, left_size < PGSIZE ? left_size : PGSIZE, offset);
+      suppl_page_table_remove (page);
     }
 }
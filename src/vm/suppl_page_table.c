@@ -1,121 +1,232 @@
 #include "suppl_page_table.h"
+#include <inttypes.h>
 #include <stdio.h>
-#include "threads/interrupt.h"
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/file.h"
 #include "threads/malloc.h"
-#include "threads/palloc.h"
 #include "threads/thread.h"
-#include "userprog/pagedir.h"
-
-struct suppl_page_elem
-  {
-    tid_t tid;
-    void *upage;
-    void *kpage;
-    bool writable;
-    struct list_elem elem;
-  };
-
-static struct list swappable_suppl_page_list;
+#include "threads/vaddr.h"
+#include "vm/frame_table.h"
+#include "vm/swap_table.h"
+
+/* Each process has its own supplemental page table, a hash of
+   struct page keyed by user virtual address.  Only the process
+   itself adds and removes entries, so the table needs no lock.
+   Eviction, done by whichever process needs a frame, changes
+   the entries of resident pages, but only while holding the
+   frame table's lock. */
+
+/* Page-in statistics. */
+static long long load_cnt;      /* # of suppl_page_table_load() calls. */
+static int64_t load_ticks;      /* Timer ticks spent in them. */
+
+static unsigned page_hash_func (const struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *page = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&page->upage, sizeof page->upage);
+}
 
-void suppl_page_table_init ()
+static bool page_less_func (const struct hash_elem *a,
+                            const struct hash_elem *b,
+                            void *aux UNUSED)
 {
-  list_init (&swappable_suppl_page_list);
+  struct page *page_a = hash_entry (a, struct page, hash_elem);
+  struct page *page_b = hash_entry (b, struct page, hash_elem);
+  return page_a->upage < page_b->upage;
 }
 
-bool suppl_page_table_add_page (void *upage, void *kpage, bool swappable, bool writable)
+static void destroy_page (struct hash_elem *e, void *aux UNUSED);
+
+/* Creates the supplemental page table of the current process.
+   Returns false if out of memory. */
+bool suppl_page_table_init (void)
 {
   struct thread *t = thread_current ();
 
-  /* Verify that there's not already a page at that virtual
-     address, then map our page there. */
-  if (pagedir_get_page (t->pagedir, upage) != NULL)
-    return false;
-  if (!pagedir_set_page (t->pagedir, upage, kpage, writable))
-    return false;
+  ASSERT (t->pages == NULL);
 
-  if (swappable)
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  if (!hash_init (t->pages, page_hash_func, page_less_func, NULL))
     {
-      struct suppl_page_elem *suppl_page_elem = malloc (sizeof *suppl_page_elem);
-      suppl_page_elem->tid = t->tid;
-      suppl_page_elem->upage = upage;
-      suppl_page_elem->kpage = kpage;
-      suppl_page_elem->writable = writable;
-      list_push_back (&swappable_suppl_page_list, &suppl_page_elem->elem);
+      free (t->pages);
+      t->pages = NULL;
+      return false;
     }
-
   return true;
 }
 
-struct suppl_page_elem *suppl_page_table_pop_swappable (void)
+/* Adds UPAGE, not yet in memory, to the current process's
+   supplemental page table.  Returns the new entry, or a null
+   pointer if UPAGE is already in the table or out of memory. */
+struct page *suppl_page_table_add (void *upage, enum page_type type,
+                                   bool writable)
 {
-  if (list_empty (&swappable_suppl_page_list))
-    return NULL;
+  ASSERT (pg_ofs (upage) == 0);
 
-  struct suppl_page_elem *suppl_page_elem = list_entry (list_pop_front (&swappable_suppl_page_list), struct suppl_page_elem, elem);
+  struct page *page = malloc (sizeof *page);
+  if (page == NULL)
+    return NULL;
 
-  enum intr_level old_level;
-  old_level = intr_disable ();
-  struct thread *t = thread_find (suppl_page_elem->tid);
-  intr_set_level (old_level);
+  page->upage = upage;
+  page->owner = thread_current ();
+  page->type = type;
+  page->writable = writable;
+  page->kpage = NULL;
+  page->evicting = false;
+  page->file = NULL;
+  page->file_ofs = 0;
+  page->file_bytes = 0;
+  if (hash_insert (thread_current ()->pages, &page->hash_elem) != NULL)
+    {
+      free (page);
+      return NULL;
+    }
+  return page;
+}
 
-  ASSERT (t != NULL);
-  pagedir_clear_page (t->pagedir, suppl_page_elem->upage);
+/* Adds the pages of a segment of the current process's
+   executable, as described for load_segment() in
+   userprog/process.c.  Pages with data from FILE are read from
+   it when first touched, and the rest are zeroed.  Returns false
+   if a page is already in the table or out of memory. */
+bool suppl_page_table_add_segment (struct file *file, off_t ofs, void *upage,
+                                   uint32_t read_bytes, uint32_t zero_bytes,
+                                   bool writable)
+{
+  uint8_t *p = upage;
 
-  return suppl_page_elem;
+  for (; read_bytes > 0 || zero_bytes > 0; p += PGSIZE, ofs += PGSIZE)
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+      struct page *page = suppl_page_table_add (p, page_read_bytes > 0
+                                                   ? PAGE_FILE : PAGE_ZERO,
+                                                writable);
+      if (page == NULL)
+        return false;
+      page->file = file;
+      page->file_ofs = ofs;
+      page->file_bytes = page_read_bytes;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+    }
+  return true;
 }
 
-void suppl_page_table_exit_thread (void)
+/* Returns the current process's entry for the page containing
+   UADDR, or a null pointer if there is none. */
+struct page *suppl_page_table_find (const void *uaddr)
 {
   struct thread *t = thread_current ();
-  struct list_elem *e;
+  struct page key;
+  struct hash_elem *e;
 
-  e = list_begin (&swappable_suppl_page_list);
-  while (e != list_end (&swappable_suppl_page_list))
-    {
-      struct suppl_page_elem *suppl_page_elem = list_entry (e, struct suppl_page_elem, elem);
-      if (t->tid == suppl_page_elem->tid)
-        {
-          e = list_remove (e);
-        }
-      else
-        {
-          e = list_next (e);
-        }
-    }
+  if (t->pages == NULL)
+    return NULL;
+  key.upage = pg_round_down (uaddr);
+  e = hash_find (t->pages, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
 }
 
-void suppl_page_table_print (void)
+/* Brings PAGE, which is not in memory, into a frame and maps it.
+   Returns false if it cannot be read from its file. */
+bool suppl_page_table_load (struct page *page)
 {
-  struct list_elem *e;
+  int64_t start = timer_ticks ();
+
+  /* Install the frame first.  This waits for any eviction of
+     PAGE still writing it out, which may change its type.
+     Read-only pages of the executable are shared with other
+     processes running it, and may already be filled. */
+  uint8_t *kpage;
+  bool loaded = true;
+  bool shared = page->type == PAGE_FILE && !page->writable;
+  if (shared)
+    {
+      bool fill;
+      kpage = frame_table_install_shared (page, &fill);
+      if (!fill)
+        goto done;
+    }
+  else
+    kpage = frame_table_install (page);
 
-  printf ("swappable_suppl_page_list (size: %ld)\n", list_size (&swappable_suppl_page_list));
-  for (e = list_begin (&swappable_suppl_page_list); e != list_end (&swappable_suppl_page_list);
-       e = list_next (e))
+  switch (page->type)
     {
-      struct suppl_page_elem *suppl_page_elem = list_entry (e, struct suppl_page_elem, elem);
-      printf ("  - tid: %d, upage: %p, kpage: %p\n",
-              suppl_page_elem->tid,
-              suppl_page_elem->upage,
-              suppl_page_elem->kpage);
+    case PAGE_ZERO:
+      memset (kpage, 0, PGSIZE);
+      break;
+
+    case PAGE_FILE:
+    case PAGE_MMAP:
+      loaded = (file_read_at (page->file, kpage, page->file_bytes,
+                              page->file_ofs)
+                == (off_t) page->file_bytes);
+      memset (kpage + page->file_bytes, 0, PGSIZE - page->file_bytes);
+      break;
+
+    case PAGE_ANON:
+      swap_table_in (page->swap_slot, kpage);
+      break;
     }
+
+  /* Other processes may be waiting to share the frame, so do not
+     leave it behind half filled. */
+  if (shared && !loaded)
+    frame_table_free_shared (kpage);
+  else
+    frame_table_unpin (kpage);
+
+ done:
+  load_cnt++;
+  load_ticks += timer_elapsed (start);
+  return loaded;
 }
 
-tid_t suppl_page_elem_get_tid (struct suppl_page_elem *elem)
+/* Removes PAGE, which must not be in memory, from the current
+   process's supplemental page table and frees it. */
+void suppl_page_table_remove (struct page *page)
 {
-  return elem->tid;
+  ASSERT (page->kpage == NULL);
+  ASSERT (page->type != PAGE_ANON);
+
+  hash_delete (thread_current ()->pages, &page->hash_elem);
+  free (page);
 }
 
-void *suppl_page_elem_get_upage (struct suppl_page_elem *elem)
+/* Prints page-in statistics. */
+void suppl_page_table_print_stats (void)
 {
-  return elem->upage;
+  printf ("Page-in: %lld pages in %"PRId64" ticks\n", load_cnt, load_ticks);
 }
 
-void *suppl_page_elem_get_kpage (struct suppl_page_elem *elem)
+/* Destroys the supplemental page table of the current process,
+   which is exiting, releasing its frames and swap slots.  The
+   frames themselves are freed along with its page directory. */
+void suppl_page_table_exit_thread (void)
 {
-  return elem->kpage;
+  struct thread *t = thread_current ();
+
+  if (t->pages == NULL)
+    return;
+
+  hash_destroy (t->pages, destroy_page);
+  free (t->pages);
+  t->pages = NULL;
 }
 
-bool suppl_page_elem_get_writable (struct suppl_page_elem *elem)
+/* Releases the frame or swap slot of the page at E, and frees
+   it. */
+static void destroy_page (struct hash_elem *e, void *aux UNUSED)
 {
-  return elem->writable;
+  struct page *page = hash_entry (e, struct page, hash_elem);
+
+  if (!frame_table_forget (page) && page->type == PAGE_ANON)
+    swap_table_free (page->swap_slot);
+  free (page);
 }
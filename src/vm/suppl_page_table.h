@@ -1,19 +1,66 @@
 #ifndef SUPPL_PAGE_TABLE_H
 #define SUPPL_PAGE_TABLE_H
 
-#include "threads/thread.h"
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
 
-struct suppl_page_elem;
+/* Where the contents of a user page come from, which decides how
+   it is brought into memory and what eviction does with it. */
+enum page_type
+  {
+    PAGE_ZERO,                  /* Zeroed; stack and BSS. */
+    PAGE_FILE,                  /* Read from an executable segment. */
+    PAGE_MMAP,                  /* Read from a mapped file, and written
+                                   back to it when dirty. */
+    PAGE_ANON                   /* Only copy is in memory or swap. */
+  };
 
-void suppl_page_table_init (void);
-bool suppl_page_table_add_page (void *upage, void *kpage, bool swappable, bool writable);
-struct suppl_page_elem *suppl_page_table_pop_swappable (void);
-void suppl_page_table_exit_thread (void);
-void suppl_page_table_print (void);
+/* An entry of a process's supplemental page table, describing
+   one of its user pages. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Process the page belongs to. */
+    enum page_type type;
+    bool writable;
+
+    /* Frame holding the page, or a null pointer if the page is
+       not in memory.  Protected by the frame table's lock. */
+    void *kpage;
+
+    /* True while eviction is writing the page out, to swap or to
+       its file, after unmapping it.  Protected by the frame
+       table's lock. */
+    bool evicting;
+
+    /* For PAGE_FILE and PAGE_MMAP, the part of FILE the page
+       holds.  The rest of the page is zero. */
+    struct file *file;
+    off_t file_ofs;
+    size_t file_bytes;
 
-tid_t suppl_page_elem_get_tid (struct suppl_page_elem *);
-void *suppl_page_elem_get_upage (struct suppl_page_elem *);
-void *suppl_page_elem_get_kpage (struct suppl_page_elem *);
-bool suppl_page_elem_get_writable (struct suppl_page_elem *);
+    /* For PAGE_ANON, the swap slot holding the page while it is
+       not in memory. */
+    size_t swap_slot;
+
+    struct hash_elem hash_elem; /* Element in thread's pages. */
+    struct list_elem share_elem; /* Element in a shared frame's
+                                    sharers. */
+  };
+
+bool suppl_page_table_init (void);
+struct page *suppl_page_table_add (void *upage, enum page_type, bool writable);
+bool suppl_page_table_add_segment (struct file *, off_t ofs, void *upage,
+                                   uint32_t read_bytes, uint32_t zero_bytes,
+                                   bool writable);
+struct page *suppl_page_table_find (const void *upage);
+bool suppl_page_table_load (struct page *);
+void suppl_page_table_remove (struct page *);
+void suppl_page_table_exit_thread (void);
+void suppl_page_table_print_stats (void);
 
 #endif /* vm/suppl_page_table.h */
@@ -1,133 +1,89 @@
 #include "swap_table.h"
 #include <bitmap.h>
+#include <debug.h>
 #include <stdio.h>
-#include "threads/malloc.h"
+#include "devices/block.h"
+#include "threads/synch.h"
 #include "threads/vaddr.h"
 
 /* SECTOR_GROUP_SIZE is 8 (=4096 / 512). It incidates how many
    block sectors are needed to save a page. */
 #define SECTOR_GROUP_SIZE (PGSIZE / BLOCK_SECTOR_SIZE)
 
-static struct hash swap_hash;
+/* A swap slot is a group of SECTOR_GROUP_SIZE sectors holding one
+   page.  Which page a slot holds is recorded by its owner, in
+   the supplemental page table. */
 static struct bitmap *sector_group_occupancy;
+static struct lock swap_lock;
 
-struct swap_table_elem
-  {
-    tid_t tid;
-    void *upage;
-    bool writable;
-    uint32_t sector_group;
-    struct hash_elem hash_elem;
-  };
-
-static unsigned swap_table_hash_func (const struct hash_elem *e, void *aux UNUSED)
-{
-  struct swap_table_elem *elem = hash_entry (e, struct swap_table_elem, hash_elem);
-  return elem->tid + (unsigned) elem->upage;
-}
-
-static bool swap_table_less_func (const struct hash_elem *a,
-                                  const struct hash_elem *b,
-                                  void *aux UNUSED)
-{
-  struct swap_table_elem *elem_a = hash_entry (a, struct swap_table_elem, hash_elem);
-  struct swap_table_elem *elem_b = hash_entry (b, struct swap_table_elem, hash_elem);
-  if (elem_a->tid < elem_b->tid)
-    return true;
-  if (elem_a->tid > elem_b->tid)
-    return false;
-  return elem_a->upage < elem_b->upage;
-}
+/* Number of pages written to and read back from swap. */
+static long long swap_out_cnt;
+static long long swap_in_cnt;
 
 void swap_table_init (void)
 {
-  hash_init (&swap_hash, &swap_table_hash_func, &swap_table_less_func, NULL);
+  lock_init (&swap_lock);
 
   struct block *swap_block = block_get_role (BLOCK_SWAP);
   sector_group_occupancy = bitmap_create (block_size (swap_block) / SECTOR_GROUP_SIZE);
 }
 
-void swap_table_insert_and_save (tid_t tid, void *upage, void *kpage, bool writable)
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot. */
+size_t swap_table_out (const void *kpage)
 {
-  ASSERT (pg_ofs (upage) == 0);
   ASSERT (pg_ofs (kpage) == 0);
 
-  struct block *swap_block = block_get_role (BLOCK_SWAP);
-  uint32_t sector_group = bitmap_scan (sector_group_occupancy, 0, 1, false);
-  bitmap_set (sector_group_occupancy, sector_group, true);
+  lock_acquire (&swap_lock);
+  size_t slot = bitmap_scan_and_flip (sector_group_occupancy, 0, 1, false);
+  if (slot == BITMAP_ERROR)
+    PANIC ("out of swap space");
+  swap_out_cnt++;
+  lock_release (&swap_lock);
 
-  struct swap_table_elem *elem = malloc (sizeof *elem);
-  elem->tid = tid;
-  elem->upage = upage;
-  elem->writable = writable;
-  elem->sector_group = sector_group;
-  hash_insert (&swap_hash, &elem->hash_elem);
+  // save kpage bytes in the swap_block, one request for the whole page
+  struct block *swap_block = block_get_role (BLOCK_SWAP);
+  struct block_request request;
+  block_request_init (&request, slot * SECTOR_GROUP_SIZE,
+                      SECTOR_GROUP_SIZE, (void *) kpage, true, NULL, NULL);
+  block_submit (swap_block, &request);
+  block_wait (&request);
 
-  block_sector_t sector = sector_group * SECTOR_GROUP_SIZE;
-  uint8_t *buffer = kpage;
-  for (int i = 0; i < SECTOR_GROUP_SIZE; ++i)
-    {
-      // save kpage bytes in the swap_block
-      block_write (swap_block, sector, buffer);
-      ++sector;
-      buffer += BLOCK_SECTOR_SIZE;
-    }
+  return slot;
 }
 
-void swap_table_load_and_remove (struct swap_table_elem *swap_table_elem, void *kpage)
+/* Reads the page in SLOT into KPAGE and frees SLOT. */
+void swap_table_in (size_t slot, void *kpage)
 {
   ASSERT (pg_ofs (kpage) == 0);
 
+  // load kpage things from the swap_block, one request for the whole page
   struct block *swap_block = block_get_role (BLOCK_SWAP);
-
-  block_sector_t sector = swap_table_elem->sector_group * SECTOR_GROUP_SIZE;
-  uint8_t *buffer = kpage;
-  for (int i = 0; i < SECTOR_GROUP_SIZE; ++i)
-    {
-      // save kpage things in the swap_block
-      block_read (swap_block, sector, buffer);
-      ++sector;
-      buffer += BLOCK_SECTOR_SIZE;
-    }
-
-  bitmap_set (sector_group_occupancy, swap_table_elem->sector_group, false);
-
-  ASSERT (hash_delete (&swap_hash, &swap_table_elem->hash_elem) != NULL);
-}
-
-struct swap_table_elem *swap_table_find (tid_t tid, void *upage)
-{
-  ASSERT (pg_ofs (upage) == 0);
-  
-  struct swap_table_elem elem_for_find;
-  elem_for_find.tid = tid;
-  elem_for_find.upage = upage;
-
-  struct hash_elem *hash_elem = hash_find (&swap_hash, &elem_for_find.hash_elem);
-  if (hash_elem == NULL)
-    return NULL;
-
-  struct swap_table_elem *elem = hash_entry (hash_elem, struct swap_table_elem, hash_elem);
-  return elem;
+  struct block_request request;
+  block_request_init (&request, slot * SECTOR_GROUP_SIZE,
+                      SECTOR_GROUP_SIZE, kpage, false, NULL, NULL);
+  block_submit (swap_block, &request);
+
+  // the slot may only be reused once it has been read, since
+  // the disk queue can reorder a later write ahead of this read
+  block_wait (&request);
+
+  lock_acquire (&swap_lock);
+  swap_in_cnt++;
+  lock_release (&swap_lock);
+  swap_table_free (slot);
 }
 
-void swap_table_print (void)
+/* Frees SLOT, whose page is no longer needed. */
+void swap_table_free (size_t slot)
 {
-  struct hash_iterator i;
-
-  printf ("swap_hash (size: %ld)\n", hash_size (&swap_hash));
-  hash_first (&i, &swap_hash);
-  while (hash_next (&i))
-    {
-      struct swap_table_elem *swap_table_elem = hash_entry (hash_cur (&i), struct swap_table_elem, hash_elem);
-      printf ("  - tid: %d, upage: %p, sector_group: %d\n",
-              swap_table_elem->tid,
-              swap_table_elem->upage,
-              swap_table_elem->sector_group);
-    }
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (sector_group_occupancy, slot));
+  bitmap_reset (sector_group_occupancy, slot);
+  lock_release (&swap_lock);
 }
 
-bool swap_table_elem_is_writable (struct swap_table_elem *swap_table_elem)
+void swap_table_print_stats (void)
 {
-  return swap_table_elem->writable;
+  printf ("Swap: %lld pages out, %lld pages in\n", swap_out_cnt, swap_in_cnt);
 }